@@ -23,21 +23,31 @@ class tiles;
 class liveness;
 class cts;
 
+// assigns an offset in shared memory to every shared layout. layouts are
+// placed by decreasing size, each in the tightest aligned gap left by the
+// layouts already placed whose live ranges overlap it.
 class allocation {
  public:
-  allocation(liveness* live) : liveness_(live) {}
+  allocation(liveness* live)
+      : allocated_size_(0), live_size_(0), liveness_(live) {}
   // accessors
   bool has_offset(const data_layout* x) const {
     return offsets_.find(x) != offsets_.end();
   }
   unsigned offset(const data_layout* x) const { return offsets_.at(x); }
+  // peak of the allocated shared memory
   unsigned allocated_size() const { return allocated_size_; }
+  // largest total size of the layouts live at the same time; no allocation
+  // can be smaller
+  unsigned live_size() const { return live_size_; }
+  unsigned wasted_size() const { return allocated_size_ - live_size_; }
   // run
   void run(ir::module& mod);
 
  private:
   std::map<const data_layout*, unsigned> offsets_;
   size_t allocated_size_;
+  size_t live_size_;
   // dependences
   liveness* liveness_;
 };
@@ -55,9 +55,12 @@ class data_layout {
   }
 
  public:
+  // the order is derived from the contiguity of the io pointers of the
+  // values unless it is given
   data_layout(id_t id, const std::vector<int>& axes,
               const std::vector<unsigned>& shape,
-              const std::vector<ir::value*>& values, analysis::align* align);
+              const std::vector<ir::value*>& values, analysis::align* align,
+              const order_t& order = {});
   // visitor
   virtual void accept(layout_visitor* vst) = 0;
   // downcast
@@ -103,7 +106,7 @@ struct scanline_layout : public data_layout {
   scanline_layout(size_t num_warps, const std::vector<int>& axes,
                   const std::vector<unsigned>& shape,
                   const std::vector<ir::value*>& values,
-                  analysis::align* align);
+                  analysis::align* align, const std::vector<int>& order = {});
   void accept(layout_visitor* vst) { vst->visit_layout_scanline(this); }
   // accessor
   int mts(size_t k) { return mts_.at(k); }
@@ -120,11 +123,26 @@ struct double_buffer_info_t {
   ir::phi_node* phi;
 };
 
+// xor swizzle of a shared buffer. with c the index along order[0] and r
+// the index along order[1], element (r, c) is stored at column
+// ((c / vec) ^ ((r / per_phase) % max_phase)) * vec + c % vec of row r, so
+// strided accesses along r spread over all banks without padding. a
+// max_phase of 1 leaves the buffer row-major.
+struct swizzle_t {
+  unsigned vec;
+  unsigned per_phase;
+  unsigned max_phase;
+  bool enabled() const { return max_phase > 1; }
+};
+
 class shared_layout : public data_layout {
  private:
   static bool is_loop_latch(ir::phi_node* phi, ir::instruction* terminator);
   static void extract_double_bufferable(
       ir::value* v, std::shared_ptr<double_buffer_info_t>& res);
+  static swizzle_t make_swizzle(const std::vector<unsigned>& shape,
+                                const std::vector<int>& order,
+                                size_t elt_bytes);
 
  public:
   shared_layout(const data_layout* arg, const std::vector<int>& axes,
@@ -134,11 +152,21 @@ class shared_layout : public data_layout {
   void accept(layout_visitor* vst) { vst->visit_layout_shared(this); }
   // accessors
   size_t get_size() { return size_; }
+  // alignment of the buffer, in bytes, so that it can be accessed with the
+  // widest vector that fits its contiguous dimension
+  size_t get_alignment() { return alignment_; }
+  // bank conflicts are avoided either by padding rows, which is already
+  // accounted for in the shape, or by swizzling them
+  size_t get_padding() { return pad_; }
+  const swizzle_t& get_swizzle() { return swizzle_; }
   ir::type* get_type() { return ty_; }
   double_buffer_info_t* get_double_buffer() { return double_buffer_.get(); }
 
  private:
   size_t size_;
+  size_t alignment_;
+  size_t pad_;
+  swizzle_t swizzle_;
   ir::type* ty_;
   std::shared_ptr<double_buffer_info_t> double_buffer_;
 };
@@ -155,6 +183,14 @@ class layouts {
   void init_hmma_tile(data_layout& layouts);
   void init_scanline_tile(data_layout& layouts);
 
+  // layout selection: estimated cost, in memory transactions, of giving
+  // a scanline layout to a group of values
+  unsigned io_cost(ir::value* ptr, int leading);
+  unsigned conversion_cost(ir::value* v, int leading);
+  std::vector<int> select_order(size_t id,
+                                const std::vector<ir::value*>& values,
+                                const std::vector<int>& default_order);
+
   void create(size_t id, const std::vector<ir::value*>& values);
 
  public:
@@ -171,6 +207,8 @@ class layouts {
   data_layout* get(ir::value* v) { return get(layout_of(v)); }
   std::map<size_t, data_layout*>& get_all() { return layouts_; }
   size_t tmp(ir::instruction* i) { return tmp_.at((ir::value*)i); }
+  // estimated cost of the layout selected for a scanline group
+  unsigned get_cost(size_t id) const { return costs_.at(id); }
 
   // execution
   void run(ir::module& mod);
@@ -183,6 +221,7 @@ class layouts {
   std::map<ir::value*, size_t> groups_;
   std::map<size_t, std::vector<ir::value*>> values_;
   std::map<size_t, data_layout*> layouts_;
+  std::map<size_t, unsigned> costs_;
   std::map<ir::value*, size_t> tmp_;
 };
 
@@ -38,22 +38,43 @@ struct segment {
   }
 };
 
+// set of slots where a layout is live, as sorted disjoint segments. a
+// buffer used inside a loop is only live across the back-edge when it is
+// live-out of the latch, and buffers of exclusive branches do not overlap.
+class live_range {
+ public:
+  void add(segment s);
+  bool empty() const { return segments_.empty(); }
+  slot_index start() const { return empty() ? 0 : segments_.front().start; }
+  slot_index end() const { return empty() ? 0 : segments_.back().end; }
+  const std::vector<segment>& get_segments() const { return segments_; }
+  bool contains(slot_index idx) const;
+  bool intersect(const live_range& other) const;
+
+ private:
+  std::vector<segment> segments_;
+};
+
 class liveness {
  private:
-  typedef std::map<shared_layout*, segment> intervals_map_t;
+  typedef std::map<shared_layout*, live_range> intervals_map_t;
 
  public:
   // constructor
   liveness(layouts* l) : layouts_(l) {}
   // accessors
   const intervals_map_t& get() const { return intervals_; }
-  segment get(shared_layout* v) const { return intervals_.at(v); }
+  const live_range& get(shared_layout* v) const { return intervals_.at(v); }
   // run
   void run(ir::module& mod);
 
+ private:
+  void run(ir::function* fn, slot_index& index);
+
  private:
   // analysis
   layouts* layouts_;
+  std::map<ir::value*, shared_layout*> layout_of_;
   intervals_map_t intervals_;
 };
 
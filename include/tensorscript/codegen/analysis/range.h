@@ -0,0 +1,65 @@
+#ifndef TENSORSCRIPT_CODEGEN_ANALYSIS_RANGE_H
+#define TENSORSCRIPT_CODEGEN_ANALYSIS_RANGE_H
+
+#include <cstdint>
+#include <map>
+
+namespace tensorscript {
+
+namespace ir {
+class value;
+class type;
+class module;
+class function;
+class binary_operator;
+class cmp_inst;
+class cast_inst;
+}  // namespace ir
+
+namespace codegen {
+namespace analysis {
+
+// signed integer ranges of the values of a module. the range of a tile
+// bounds all of its elements, and booleans lie in [0, 1]. phi nodes are
+// iterated to a fixed point, and bounds that keep growing are widened to
+// those of their type. max_value hints on arguments and instructions bound
+// their upper end; this is where those hints are consumed.
+class range {
+ public:
+  struct interval_t {
+    int64_t lo;
+    int64_t hi;
+    bool empty() const { return lo > hi; }
+    bool operator==(const interval_t& other) const {
+      return lo == other.lo && hi == other.hi;
+    }
+    bool operator!=(const interval_t& other) const { return !(*this == other); }
+  };
+
+ private:
+  static interval_t full(ir::type* ty);
+  static interval_t clamp(ir::type* ty, __int128 lo, __int128 hi);
+  interval_t get_or_empty(ir::value* v);
+  interval_t compute_binop(ir::binary_operator* x);
+  interval_t compute_cmp(ir::cmp_inst* x);
+  interval_t compute_cast(ir::cast_inst* x);
+  interval_t compute(ir::value* v);
+  void run(ir::function* fn);
+
+ public:
+  range() {}
+  void run(ir::module& mod);
+  // range of an integer value; the range of its type when unknown
+  interval_t get(ir::value* v);
+  // whether a boolean value is true for every element
+  bool is_true(ir::value* v);
+
+ private:
+  std::map<ir::value*, interval_t> ranges_;
+};
+
+}  // namespace analysis
+}  // namespace codegen
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_CODEGEN_ANALYSIS_RANGE_H
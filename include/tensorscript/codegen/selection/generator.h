@@ -63,7 +63,8 @@ namespace codegen {
 
 class generator : public ir::visitor, public analysis::layout_visitor {
  private:
-  void for_each(ir::value* x, const std::function<void(indices_t)>& fn);
+  template <class F>
+  void for_each(ir::value* x, const F& fn);
   Value* get_value(ir::value* x, const indices_t& idx);
   void set_value(ir::value* x, const indices_t& idx, Value* v);
 
@@ -76,6 +77,12 @@ class generator : public ir::visitor, public analysis::layout_visitor {
                        distributed_tile* TB, distributed_tile* TD, unsigned NK,
                        Type* c_ty, Function* f_mul_add);
 
+  // loop lowering of element-wise instructions
+  bool is_loop_candidate(ir::instruction* x);
+  Value* get_storage(distributed_tile* tile);
+  Value* emit_elementwise(ir::instruction* x, const std::vector<Value*>& ops);
+  void emit_loop(ir::instruction* x);
+
   void finalize_shared_layout(analysis::shared_layout*);
   void finalize_function(ir::function*);
   void finalize_phi_node(ir::phi_node*);
@@ -83,7 +90,7 @@ class generator : public ir::visitor, public analysis::layout_visitor {
  public:
   generator(analysis::axes* a_axes, analysis::layouts* layouts,
             analysis::align* alignment, analysis::allocation* alloc,
-            target* tgt, unsigned num_warps);
+            target* tgt, unsigned num_warps, unsigned loop_unroll = 0);
 
   void visit_value(ir::value* v);
 
@@ -159,6 +166,9 @@ class generator : public ir::visitor, public analysis::layout_visitor {
   analysis::allocation* alloc_;
   Value* sh_mem_ptr_;
   unsigned num_warps_;
+  // element-wise instructions on tiles with more elements per thread are
+  // lowered to loops unrolled by this factor (0: fully unrolled code)
+  unsigned loop_unroll_;
 
   std::set<ir::value*> seen_;
 };
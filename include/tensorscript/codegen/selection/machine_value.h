@@ -2,9 +2,11 @@
 #define TENSORSCRIPT_CODEGEN_SELECTION_MACHINE_VALUE_H
 
 #include <functional>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
+#include "tensorscript/codegen/analysis/layout.h"
+
 namespace llvm {
 class Type;
 class Value;
@@ -56,6 +58,15 @@ class distributed_tile;
 class target;
 typedef std::vector<Value*> indices_t;
 
+struct indices_hash {
+  size_t operator()(const indices_t& idx) const {
+    size_t result = idx.size();
+    for (Value* x : idx)
+      result = result * 31 + std::hash<Value*>()(x);
+    return result;
+  }
+};
+
 }  // namespace codegen
 }  // namespace tensorscript
 
@@ -74,8 +85,8 @@ class tile {
 
  public:
   tile(Type* ty, const shapes_t& shapes) : ty_(ty), shapes_(shapes) {}
-  virtual void set_value(indices_t idx, Value* v) = 0;
-  virtual Value* get_value(indices_t idx) = 0;
+  virtual void set_value(const indices_t& idx, Value* v) = 0;
+  virtual Value* get_value(const indices_t& idx) = 0;
   Type* get_ty() const { return ty_; }
   shapes_t get_shapes() const { return shapes_; }
 
@@ -96,34 +107,40 @@ class shared_tile : public tile {
               const std::vector<int>& perm = {});
   void set_vector_size(unsigned vector_size);
   void set_return_mode(bool return_vector);
-  void set_value(indices_t, Value*);
+  void set_value(const indices_t& idx, Value* v);
   Value* get_ptr_to(indices_t idx);
-  Value* get_value(indices_t idx);
+  Value* get_value(const indices_t& idx);
   Value* get_pointer() { return ptr_; }
   Value* get_offset() { return offset_; }
   const std::vector<int>& get_perm() { return perm_; }
   const std::vector<int>& get_order() { return order_; }
-  static Value* shared_offset(Builder& builder, const shapes_t& shapes,
-                              const std::vector<int>& perm,
-                              const std::vector<int>& order, indices_t idx);
+  void set_swizzle(const analysis::swizzle_t& swizzle) { swizzle_ = swizzle; }
+  const analysis::swizzle_t& get_swizzle() { return swizzle_; }
+  static Value* shared_offset(
+      Builder& builder, const shapes_t& shapes, const std::vector<int>& perm,
+      const std::vector<int>& order, indices_t idx,
+      const analysis::swizzle_t& swizzle = analysis::swizzle_t{1, 1, 1});
 
  private:
   Value* ptr_;
   bool return_vector_;
   Builder& builder_;
   Value* offset_;
-  std::map<indices_t, Value*> ptr_cache_;
+  std::unordered_map<indices_t, Value*, indices_hash> ptr_cache_;
   unsigned vector_size_;
   std::vector<int> order_;
   std::vector<int> perm_;
+  analysis::swizzle_t swizzle_;
 };
 
 // Distribtued tile
 class distributed_tile : public tile {
   typedef std::vector<distributed_axis> axes_t;
   typedef std::vector<indices_t> ordered_indices_vec_t;
-  typedef std::map<indices_t, unsigned> indices_map_t;
-  typedef std::map<indices_t, Value*> values_map_t;
+  // position of each axis value, per dimension
+  typedef std::vector<std::unordered_map<Value*, unsigned>> positions_t;
+  // one slot per element, indexed by linear index
+  typedef std::vector<Value*> values_t;
 
  private:
   void init_indices();
@@ -132,23 +149,55 @@ class distributed_tile : public tile {
   distributed_tile(Type* ty, const shapes_t& shapes,
                    const std::vector<int>& order, const axes_t& axes,
                    Builder& builder);
-  void set_value(indices_t idx, Value* v);
-  Value* get_value(indices_t idx);
+  void set_value(const indices_t& idx, Value* v);
+  Value* get_value(const indices_t& idx);
   const std::vector<int>& get_order() { return order_; }
-  unsigned get_linear_index(indices_t idx);
-  indices_t get_ordered_indices(unsigned id);
-  void for_each(std::function<void(indices_t)> fn, int start = 0, int end = -1);
-  void for_each(std::function<void(indices_t)> fn, std::vector<int> start,
-                std::vector<int> size);
+  // values may live in memory (one element per linear index) instead of
+  // registers; unset elements are then loaded on demand
+  void set_storage(Value* ptr) { storage_ = ptr; }
+  Value* get_storage() { return storage_; }
+  size_t size() const { return ordered_indices_.size(); }
+  unsigned get_linear_index(const indices_t& idx) const;
+  const indices_t& get_ordered_indices(unsigned id) const {
+    return ordered_indices_.at(id);
+  }
+
+  template <class F>
+  void for_each(const F& fn, int start = 0, int end = -1) {
+    if (end < 0)
+      end = ordered_indices_.size() + end + 1;
+    for (int i = start; i < end; i++)
+      fn(ordered_indices_[i]);
+  }
+
+  template <class F>
+  void for_each(const F& fn, const std::vector<int>& starts,
+                const std::vector<int>& sizes) {
+    size_t rank = sizes.size();
+    int len = 1;
+    for (int s : sizes)
+      len *= s;
+    indices_t idx(rank);
+    for (int i = 0; i < len; i++) {
+      int current = i;
+      for (size_t k = 0; k < rank; k++) {
+        idx[k] = axes_[k].values.at(starts[k] + current % sizes[k]);
+        current = current / sizes[k];
+      }
+      fn(idx);
+    }
+  }
 
   const distributed_axis& axis(unsigned dim) { return axes_.at(dim); }
 
  private:
   axes_t axes_;
   std::vector<int> order_;
-  indices_map_t indices_;
-  values_map_t values_;
+  positions_t positions_;
+  std::vector<unsigned> strides_;
+  values_t values_;
   ordered_indices_vec_t ordered_indices_;
+  Value* storage_;
   Builder& builder_;
 };
 
@@ -43,8 +43,10 @@ class target {
                           Function* fn) = 0;
   virtual Instruction* add_barrier(Module* module, Builder& builder) = 0;
   virtual Instruction* add_memfence(Module* module, Builder& builder) = 0;
+  // stride * block id, computed in index_ty (i32 or i64)
   virtual Value* get_global_offset(Module* module, Builder& builder,
-                                   unsigned stride, unsigned ax) = 0;
+                                   unsigned stride, unsigned ax,
+                                   Type* index_ty) = 0;
   virtual Value* get_local_id(Module* module, Builder& builder,
                               unsigned ax) = 0;
   virtual Value* get_block_id(Module* module, Builder& builder,
@@ -66,7 +68,7 @@ class amd_cl_target : public target {
   Instruction* add_barrier(Module* module, Builder& builder);
   Instruction* add_memfence(Module* module, Builder& builder);
   Value* get_global_offset(Module* module, Builder& builder, unsigned stride,
-                           unsigned ax);
+                           unsigned ax, Type* index_ty);
   Value* get_local_id(Module* module, Builder& builder, unsigned ax);
   Value* get_block_id(Module* module, Builder& builder, unsigned ax);
   Value* get_num_blocks(Module* module, Builder& builder, unsigned ax);
@@ -81,7 +83,7 @@ class nvidia_cu_target : public target {
   Instruction* add_barrier(Module* module, Builder& builder);
   Instruction* add_memfence(Module* module, Builder& builder);
   Value* get_global_offset(Module* module, Builder& builder, unsigned stride,
-                           unsigned ax);
+                           unsigned ax, Type* index_ty);
   Value* get_local_id(Module* module, Builder& builder, unsigned ax);
   Value* get_block_id(Module* module, Builder& builder, unsigned ax);
   Value* get_num_blocks(Module* module, Builder& builder, unsigned ax);
@@ -96,7 +98,7 @@ class cpu_target : public target {
   Instruction* add_barrier(Module* module, Builder& builder);
   Instruction* add_memfence(Module* module, Builder& builder);
   Value* get_global_offset(Module* module, Builder& builder, unsigned stride,
-                           unsigned ax);
+                           unsigned ax, Type* index_ty);
   Value* get_local_id(Module* module, Builder& builder, unsigned ax);
   Value* get_block_id(Module* module, Builder& builder, unsigned ax);
   Value* get_num_blocks(Module* module, Builder& builder, unsigned ax);
@@ -1,19 +1,47 @@
 #ifndef TENSORSCRIPT_CODEGEN_TRANSFORM_DCE_H
 #define TENSORSCRIPT_CODEGEN_TRANSFORM_DCE_H
 
+#include <map>
+#include <set>
+#include <vector>
+
 namespace tensorscript {
 
 namespace ir {
 class module;
-}
+class function;
+class basic_block;
+class instruction;
+class cond_branch_inst;
+class builder;
+}  // namespace ir
 
 namespace codegen {
 namespace transform {
 
+// aggressive dead code elimination. instructions are dead unless they have
+// side effects or a live instruction depends on them, either through its
+// operands or through the conditional branches it is control-dependent on.
+// dead conditional branches jump to their nearest post-dominator; the
+// blocks this leaves empty or unreachable are removed by simplify_cfg.
 class dce {
+ private:
+  void compute_post_dominators(ir::function* fn);
+  ir::basic_block* get_post_idom(ir::basic_block* block);
+  void mark(ir::instruction* i);
+  void propagate();
+  bool can_bypass(ir::cond_branch_inst* br);
+  void run(ir::function* fn, ir::builder& builder);
+
  public:
   dce() {}
   void run(ir::module& mod);
+
+ private:
+  std::set<ir::instruction*> marked_;
+  std::vector<ir::instruction*> work_list_;
+  std::map<ir::basic_block*, std::set<ir::basic_block*>> post_dom_;
+  std::map<ir::basic_block*, std::set<ir::basic_block*>> control_deps_;
 };
 
 }  // namespace transform
@@ -1,7 +1,9 @@
 #ifndef TENSORSCRIPT_CODEGEN_TRANSFORM_MEMBAR_H
 #define TENSORSCRIPT_CODEGEN_TRANSFORM_MEMBAR_H
 
+#include <map>
 #include <set>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -9,6 +11,7 @@ namespace tensorscript {
 
 namespace ir {
 class module;
+class function;
 class basic_block;
 class instruction;
 class value;
@@ -21,6 +24,7 @@ namespace analysis {
 
 class allocation;
 class liveness;
+class shared_layout;
 class layouts;
 class cts;
 
@@ -28,34 +32,71 @@ class cts;
 
 namespace transform {
 
+// inserts the barriers needed between shared memory accesses of different
+// threads. the accesses pending since the last barrier are propagated over
+// the CFG until a fixed point is reached. barriers already in the IR, e.g.,
+// from builder::create_barrier, are kept and synchronize like inserted ones.
 class membar {
  private:
   typedef std::pair<unsigned, unsigned> interval_t;
-  typedef std::vector<interval_t> interval_vec_t;
+  // shared memory accessed by an instruction. accesses to the half of a
+  // double buffer that is filled for the next iteration are tagged, as
+  // they never overlap with reads of the current half of the same
+  // iteration. reads carried over a back-edge are tagged as well, since
+  // the halves are swapped by then
+  struct access_t {
+    interval_t interval;
+    analysis::shared_layout* layout;
+    bool next;
+    bool carried;
+    bool operator<(const access_t& other) const {
+      return std::tie(interval, layout, next, carried) <
+             std::tie(other.interval, other.layout, other.next,
+                      other.carried);
+    }
+    bool operator==(const access_t& other) const {
+      return interval == other.interval && layout == other.layout &&
+             next == other.next && carried == other.carried;
+    }
+  };
+  typedef std::set<access_t> access_set_t;
+  // accesses that are not yet synchronized
+  struct state_t {
+    access_set_t written;
+    access_set_t read;
+    bool operator==(const state_t& other) const {
+      return written == other.written && read == other.read;
+    }
+    bool operator!=(const state_t& other) const { return !(*this == other); }
+  };
 
  private:
-  interval_vec_t join(const std::vector<interval_vec_t>& intervals);
-  void insert_barrier(ir::instruction* instr, ir::builder& builder);
-  bool intersect(const interval_vec_t& X, interval_t x);
-  bool intersect(const interval_vec_t& X, const interval_vec_t& Y);
-  void add_reference(ir::value* v, interval_vec_t& res);
-  void get_read_intervals(ir::instruction* i, interval_vec_t& res);
-  void get_written_intervals(ir::instruction* i, interval_vec_t& res);
-  std::pair<interval_vec_t, interval_vec_t> transfer(
-      ir::basic_block* block, const interval_vec_t& written_to,
-      const interval_vec_t& read_from, std::set<ir::instruction*>& insert_loc,
-      std::set<tensorscript::ir::value*>& safe_war);
+  void add_reference(ir::value* v, bool next, access_set_t& res);
+  void get_accesses(ir::instruction* i, access_set_t& read,
+                    access_set_t& written);
+  static bool read_after_write(const access_set_t& written,
+                               const access_set_t& read);
+  static bool write_after_read(const access_set_t& read,
+                               const access_set_t& written);
+  state_t transfer(ir::basic_block* block, state_t state,
+                   std::set<ir::instruction*>& insert_loc);
+  void run(ir::function* fn, ir::builder& builder);
 
  public:
   membar(analysis::liveness* liveness, analysis::layouts* layouts,
          analysis::allocation* alloc)
       : liveness_(liveness), layouts_(layouts), alloc_(alloc) {}
   void run(ir::module& mod);
+  // number of barriers in a kernel after the pass
+  unsigned get_num_barriers(ir::function* fn) const {
+    return num_barriers_.at(fn);
+  }
 
  private:
   analysis::liveness* liveness_;
   analysis::layouts* layouts_;
   analysis::allocation* alloc_;
+  std::map<ir::function*, unsigned> num_barriers_;
 };
 
 }  // namespace transform
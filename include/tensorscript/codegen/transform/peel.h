@@ -0,0 +1,79 @@
+#ifndef TENSORSCRIPT_CODEGEN_TRANSFORM_PEEL_H
+#define TENSORSCRIPT_CODEGEN_TRANSFORM_PEEL_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "tensorscript/ir/enums.h"
+
+namespace tensorscript {
+
+namespace ir {
+class module;
+class value;
+class basic_block;
+class instruction;
+class builder;
+}  // namespace ir
+
+namespace codegen {
+
+namespace analysis {
+class range;
+}
+
+namespace transform {
+
+// splits single-block loops whose masked loads and stores are only partial
+// near the bounds, e.g., the K-loops of matrix multiplications. a copy of
+// the loop runs with unmasked I/O as long as a scalar guard proves that the
+// masks of the next iteration are all-true; a masked copy of the loop then
+// finishes the remaining iterations, usually a single one. the original
+// loop only runs when the first iteration is already partial. the phi
+// nodes of every loop keep one incoming value from outside and one from the
+// latch, so they are double-buffered like those of the original loop. runs
+// before cts.
+class peel {
+ private:
+  // pred(scalar, bound) implies that some mask is all-true
+  struct guard_t {
+    ir::value* scalar;
+    ir::cmp_pred_t pred;
+    int64_t bound;
+    bool operator==(const guard_t& other) const {
+      return scalar == other.scalar && pred == other.pred &&
+             bound == other.bound;
+    }
+  };
+  typedef std::map<ir::value*, ir::value*> value_map_t;
+
+ private:
+  static bool is_rematerializable(ir::value* v, ir::basic_block* loop);
+  static ir::value* rematerialize(ir::value* v, ir::basic_block* loop,
+                                  value_map_t& vmap, ir::builder& builder);
+  bool collect_guards(ir::value* mask, ir::basic_block* loop,
+                      std::vector<guard_t>& guards);
+  ir::value* create_guard(const std::vector<guard_t>& guards,
+                          ir::basic_block* loop, value_map_t& vmap,
+                          ir::builder& builder);
+  static void clone_body(ir::basic_block* loop, ir::basic_block* block,
+                         ir::basic_block* pred, const value_map_t& init,
+                         const std::set<ir::instruction*>& unmasked,
+                         value_map_t& vmap, ir::builder& builder);
+  bool run(ir::basic_block* loop, ir::builder& builder);
+
+ public:
+  peel(analysis::range* range) : range_(range) {}
+  void run(ir::module& mod);
+
+ private:
+  analysis::range* range_;
+};
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_CODEGEN_TRANSFORM_PEEL_H
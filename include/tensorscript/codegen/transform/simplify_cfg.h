@@ -0,0 +1,38 @@
+#ifndef TENSORSCRIPT_CODEGEN_TRANSFORM_SIMPLIFY_CFG_H
+#define TENSORSCRIPT_CODEGEN_TRANSFORM_SIMPLIFY_CFG_H
+
+namespace tensorscript {
+
+namespace ir {
+class module;
+class function;
+class basic_block;
+class builder;
+}  // namespace ir
+
+namespace codegen {
+namespace transform {
+
+// simplifies the control flow of functions, until a fixed point:
+// conditional branches on constants (e.g., folded by specialization) become
+// unconditional, unreachable blocks are removed, blocks that only jump
+// elsewhere are bypassed, and blocks are merged into their single
+// predecessor when it only jumps to them
+class simplify_cfg {
+ private:
+  static void remove_incoming(ir::basic_block* block, ir::basic_block* pred);
+  bool fold_branches(ir::function* fn);
+  bool remove_unreachable(ir::function* fn);
+  bool bypass_empty(ir::function* fn);
+  bool merge_blocks(ir::function* fn);
+
+ public:
+  simplify_cfg() {}
+  void run(ir::module& mod);
+};
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_CODEGEN_TRANSFORM_SIMPLIFY_CFG_H
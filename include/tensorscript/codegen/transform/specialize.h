@@ -0,0 +1,45 @@
+#ifndef TENSORSCRIPT_CODEGEN_TRANSFORM_SPECIALIZE_H
+#define TENSORSCRIPT_CODEGEN_TRANSFORM_SPECIALIZE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace tensorscript {
+
+namespace ir {
+class module;
+}
+
+namespace codegen {
+
+// cheap predicates on kernel arguments a kernel variant is compiled for.
+// divisible_by_16 means aligned to 16 bytes for pointers
+enum arg_property_t : uint8_t {
+  arg_generic = 0,
+  arg_equal_to_1 = 1,
+  arg_divisible_by_16 = 2
+};
+
+// one property per kernel argument
+typedef std::vector<arg_property_t> specialization_key_t;
+
+namespace transform {
+
+// folds the properties of a specialization key into the kernels of a
+// module: integer arguments equal to 1 are replaced by the constant, and
+// divisibility becomes a multiple_of or aligned attribute. align and
+// peephole then drop the scalar paths and masks they no longer need.
+class specialize {
+ public:
+  specialize(const specialization_key_t& key) : key_(key) {}
+  void run(ir::module& mod);
+
+ private:
+  specialization_key_t key_;
+};
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_CODEGEN_TRANSFORM_SPECIALIZE_H
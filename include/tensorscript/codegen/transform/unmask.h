@@ -0,0 +1,38 @@
+#ifndef TENSORSCRIPT_CODEGEN_TRANSFORM_UNMASK_H
+#define TENSORSCRIPT_CODEGEN_TRANSFORM_UNMASK_H
+
+namespace tensorscript {
+
+namespace ir {
+class module;
+class instruction;
+}  // namespace ir
+
+namespace codegen {
+
+namespace analysis {
+class range;
+}
+
+namespace transform {
+
+// rewrites masked loads and stores whose mask is provably all-true into
+// unmasked ones, and removes the computations of the masks that become
+// dead
+class unmask {
+ private:
+  void erase_dead(ir::instruction* i);
+
+ public:
+  unmask(analysis::range* range) : range_(range) {}
+  void run(ir::module& mod);
+
+ private:
+  analysis::range* range_;
+};
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_CODEGEN_TRANSFORM_UNMASK_H
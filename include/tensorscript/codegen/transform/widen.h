@@ -0,0 +1,54 @@
+#ifndef TENSORSCRIPT_CODEGEN_TRANSFORM_WIDEN_H
+#define TENSORSCRIPT_CODEGEN_TRANSFORM_WIDEN_H
+
+#include <map>
+#include <set>
+
+namespace tensorscript {
+
+namespace ir {
+class module;
+class function;
+class value;
+class instruction;
+class builder;
+}  // namespace ir
+
+namespace codegen {
+
+namespace analysis {
+class range;
+}
+
+namespace transform {
+
+// 64-bit indexing, e.g., for tensors of more than 2^31 elements. with
+// index_bits = 64, the indices of getelementptr instructions are computed
+// in 64-bit arithmetic from sign-extended leaves, and program ids become
+// 64-bit. comparisons of those indices, e.g., the bounds checks of masks,
+// are computed in 64-bit as well. indices whose arithmetic provably never
+// wraps around in its 32-bit type keep 32-bit math. with index_bits = 32
+// (the default), the pass does nothing.
+class widen {
+ private:
+  static bool is_widenable(ir::instruction* i);
+  bool is_safe(ir::value* v, std::set<ir::value*>& seen);
+  ir::value* get_wide(ir::value* v, ir::function* fn, ir::builder& builder);
+  void run(ir::function* fn, ir::builder& builder);
+
+ public:
+  widen(analysis::range* range, unsigned index_bits = 32)
+      : range_(range), index_bits_(index_bits) {}
+  void run(ir::module& mod);
+
+ private:
+  analysis::range* range_;
+  unsigned index_bits_;
+  std::map<ir::value*, ir::value*> wide_;
+};
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_CODEGEN_TRANSFORM_WIDEN_H
@@ -1,11 +1,17 @@
 #ifndef TENSORSCRIPT_DRIVER_BACKEND_H
 #define TENSORSCRIPT_DRIVER_BACKEND_H
 
+#include <atomic>
 #include <list>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
 #include <vector>
 
 #include "tensorscript/driver/context.h"
+#include "tensorscript/tools/sharded_map.h"
 
 namespace llvm {
 class Module;
@@ -23,6 +29,17 @@ class module;
 class kernel;
 
 struct backend {
+ private:
+  // shard selector for (resource, name) keys
+  struct key_hash {
+    template <class T>
+    size_t operator()(const std::tuple<T*, std::string>& key) const {
+      return std::hash<T*>()(std::get<0>(key)) ^
+             std::hash<std::string>()(std::get<1>(key));
+    }
+  };
+
+ public:
   // platforms
   class platforms {
     friend class backend;
@@ -59,7 +76,8 @@ struct backend {
     static void release();
 
    private:
-    static std::map<std::tuple<driver::stream*, std::string>, driver::module*>
+    static tools::sharded_map<std::tuple<driver::stream*, std::string>,
+                              driver::module*, key_hash>
         cache_;
   };
 
@@ -72,7 +90,9 @@ struct backend {
     static driver::kernel* get(driver::module* mod, const std::string& name);
 
    private:
-    static std::map<std::tuple<module*, std::string>, driver::kernel*> cache_;
+    static tools::sharded_map<std::tuple<module*, std::string>,
+                              driver::kernel*, key_hash>
+        cache_;
   };
 
   // contexts
@@ -86,20 +106,16 @@ struct backend {
    public:
     static driver::context* get_default();
 
-    static driver::context* import(CUcontext ctx) {
-      for (driver::context* x : cache_) {
-        driver::cu_context* cu_x = (driver::cu_context*)x;
-        if (*cu_x->cu() == ctx)
-          return x;
-      }
-      cache_.emplace_back(new driver::cu_context(ctx, false));
-      return cache_.back();
-    }
+    static driver::context* import(CUcontext ctx);
 
     static void get(std::list<driver::context*>&);
 
+   private:
+    static driver::context* find(CUcontext ctx);
+
    private:
     static std::list<driver::context*> cache_;
+    static std::shared_mutex mutex_;
   };
 
   // streams
@@ -112,11 +128,13 @@ struct backend {
 
    public:
     static void get(driver::context*, std::vector<driver::stream*>& streams);
+    // streams with id beyond the current count are created on demand
     static driver::stream* get(driver::context*, unsigned int id = 0);
     static driver::stream* get_default();
 
    private:
     static std::map<driver::context*, std::vector<driver::stream*> > cache_;
+    static std::shared_mutex mutex_;
   };
 
   static void init();
@@ -124,6 +142,10 @@ struct backend {
   static void synchronize(tensorscript::driver::context*);
 
   static unsigned int default_device;
+
+ private:
+  static std::atomic<bool> initialized_;
+  static std::mutex init_mutex_;
 };
 
 }  // namespace driver
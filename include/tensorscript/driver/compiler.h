@@ -0,0 +1,122 @@
+#ifndef TENSORSCRIPT_DRIVER_COMPILER_H
+#define TENSORSCRIPT_DRIVER_COMPILER_H
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tensorscript/codegen/transform/specialize.h"
+#include "tensorscript/tools/thread_pool.h"
+
+namespace llvm {
+class Module;
+class LLVMContext;
+}  // namespace llvm
+
+namespace tensorscript {
+namespace driver {
+
+class context;
+class module;
+class kernel;
+struct compile_job;
+
+// emits the llvm module of a kernel into the given (job-private) context
+typedef std::function<std::unique_ptr<llvm::Module>(llvm::LLVMContext&)>
+    codegen_fn_t;
+
+// handle on a kernel being compiled in the background.
+// copies share the same compilation job.
+class async_kernel {
+  friend class compiler;
+
+ public:
+  async_kernel();
+  bool valid() const;
+  bool ready() const;
+  void wait() const;
+  // blocks until the kernel is compiled; a job still waiting in the queue
+  // is moved to the front. rethrows compilation errors.
+  driver::kernel* get() const;
+  driver::module* module() const;
+
+ private:
+  std::shared_ptr<compile_job> job_;
+};
+
+// background compilation on the host executor (tools::get_executor()).
+// every job gets its own llvm::LLVMContext and target machine so jobs never
+// share LLVM state and run concurrently. jobs wait in a priority queue and
+// every executor task runs the most urgent one.
+class compiler {
+ private:
+  void run_next();
+  void run(compile_job& job);
+
+ public:
+  compiler(tools::executor* exec = tools::get_executor());
+  // waits for the queued jobs
+  ~compiler();
+  async_kernel compile(driver::context* ctx, codegen_fn_t codegen,
+                       const std::string& name, int priority = 0);
+  // compile candidate configurations (e.g., autotuning) concurrently
+  std::vector<async_kernel> compile_all(
+      driver::context* ctx, const std::vector<codegen_fn_t>& candidates,
+      const std::string& name, int priority = 0);
+  // raise the priority of a job if it has not started yet
+  void promote(compile_job& job, int priority);
+  tools::executor* get_executor() const { return exec_; }
+  static compiler* get_default();
+
+ private:
+  tools::executor* exec_;
+  std::vector<std::shared_ptr<compile_job>> queue_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+  // submission order of the next job, guarded by mutex_
+  size_t next_order_;
+  // executor tasks not finished yet, guarded by mutex_
+  size_t num_tasks_;
+};
+
+// kernel compiled once per specialization key. the key of a launch is
+// derived from the raw argument values, and the codegen receives it to fold
+// the properties into the IR (see codegen::transform::specialize).
+class specialized_kernel {
+ public:
+  typedef std::function<std::unique_ptr<llvm::Module>(
+      llvm::LLVMContext&, const codegen::specialization_key_t&)>
+      codegen_fn_t;
+
+ public:
+  // specializable[i] is a mask of the properties argument i may be
+  // specialized for
+  specialized_kernel(compiler* comp, driver::context* ctx, codegen_fn_t codegen,
+                     const std::string& name,
+                     const std::vector<uint8_t>& specializable);
+  // args holds integer values and pointer addresses
+  codegen::specialization_key_t get_key(
+      const std::vector<uint64_t>& args) const;
+  // variant matching the arguments; compiled on first use
+  async_kernel get(const std::vector<uint64_t>& args);
+  size_t num_variants() const;
+
+ private:
+  compiler* compiler_;
+  driver::context* ctx_;
+  codegen_fn_t codegen_;
+  std::string name_;
+  std::vector<uint8_t> specializable_;
+  mutable std::mutex mutex_;
+  std::map<codegen::specialization_key_t, async_kernel> variants_;
+};
+
+}  // namespace driver
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_DRIVER_COMPILER_H
@@ -1,6 +1,9 @@
 #ifndef TENSORSCRIPT_DRIVER_EVENT_H
 #define TENSORSCRIPT_DRIVER_EVENT_H
 
+#include <functional>
+#include <memory>
+
 #include "tensorscript/driver/handle.h"
 
 namespace tensorscript {
@@ -8,13 +11,26 @@ namespace tensorscript {
 namespace driver {
 
 // event
+// copies share the same underlying event, so an event handed to a stream
+// can be waited on from anywhere
 class event {
  public:
+  event();
   float elapsed_time() const;
   handle<cu_event_t> const& cu() const;
+  // host events
+  std::shared_ptr<host_event_t> const& hst() const;
+  void reset();
+  void record_start();
+  void record_end();
+  bool query() const;
+  void synchronize() const;
+  // run fn once the event completed (immediately if it already did)
+  void then(std::function<void()> fn) const;
 
  private:
   handle<cu_event_t> cu_;
+  std::shared_ptr<host_event_t> hst_;
 };
 
 }  // namespace driver
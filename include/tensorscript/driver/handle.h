@@ -1,17 +1,22 @@
 #ifndef TENSORSCRIPT_DRIVER_HANDLE_H
 #define TENSORSCRIPT_DRIVER_HANDLE_H
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include "tensorscript/driver/dispatch.h"
 
 namespace llvm {
 class ExecutionEngine;
 class Function;
+class LLVMContext;
 }  // namespace llvm
 
 namespace tensorscript {
@@ -33,6 +38,8 @@ struct host_module_t {
   std::string error;
   llvm::ExecutionEngine* engine;
   std::map<std::string, llvm::Function*> functions;
+  // keeps the context of the jitted module alive
+  std::shared_ptr<llvm::LLVMContext> llvm_ctx;
 };
 
 struct host_function_t {
@@ -43,6 +50,18 @@ struct host_buffer_t {
   char* data;
 };
 
+struct host_event_t {
+  typedef std::chrono::high_resolution_clock clock_t;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = true;
+  bool recorded = false;
+  clock_t::time_point start;
+  clock_t::time_point end;
+  // continuations waiting for completion
+  std::vector<std::function<void()>> callbacks;
+};
+
 // Extra CUDA handles
 struct cu_event_t {
   operator bool() const { return first && second; }
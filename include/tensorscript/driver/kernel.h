@@ -49,6 +49,7 @@ class host_kernel : public kernel {
   void setArg(unsigned int index, driver::buffer* buffer);
   // Params
   const std::vector<void*>& params();
+  const std::vector<std::shared_ptr<void> >& params_store();
 
  private:
   std::vector<std::shared_ptr<void> > params_store_;
@@ -23,9 +23,11 @@ class cu_device;
 // Base
 class module
     : public polymorphic_resource<CUmodule, cl_program, host_module_t> {
- protected:
-  void init_llvm();
+ public:
+  // thread-safe, idempotent LLVM target initialization
+  static void init_llvm();
 
+ protected:
   enum file_type_t { Object, Assembly };
 
  public:
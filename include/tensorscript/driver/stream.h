@@ -1,11 +1,18 @@
 #ifndef TENSORSCRIPT_DRIVER_STREAM_H
 #define TENSORSCRIPT_DRIVER_STREAM_H
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 
 #include "tensorscript/driver/buffer.h"
 #include "tensorscript/driver/context.h"
 #include "tensorscript/driver/device.h"
+#include "tensorscript/driver/event.h"
 #include "tensorscript/driver/handle.h"
 
 namespace tensorscript {
@@ -55,10 +62,39 @@ class stream
 };
 
 // Host
+// commands run in order on the host executor (tools::get_executor());
+// distinct streams run concurrently.
+// the destructor waits for the commands that can run. commands still
+// waiting for an event of another stream are detached: they keep their
+// queue alive and run once the event completes, so the buffers they use
+// must outlive them.
 class host_stream : public stream {
+  struct command_t {
+    std::function<void()> fn;
+    std::vector<event> deps;
+    std::vector<event> signal;
+  };
+
+  // state shared with the executor tasks and event callbacks
+  struct queue_t {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<command_t> commands;
+    bool running = false;
+    // waiting for an event of another stream
+    bool deferred = false;
+    std::exception_ptr error;
+  };
+
+ private:
+  void push(std::function<void()> fn, std::vector<event> const* deps,
+            event* event);
+  static void drain(const std::shared_ptr<queue_t>& queue);
+
  public:
   // Constructors
   host_stream(driver::context* ctx);
+  ~host_stream();
 
   // Overridden
   void synchronize();
@@ -69,6 +105,9 @@ class host_stream : public stream {
              std::size_t size, void const* ptr);
   void read(driver::buffer* buf, bool blocking, std::size_t offset,
             std::size_t size, void* ptr);
+
+ private:
+  std::shared_ptr<queue_t> queue_;
 };
 
 // OpenCL
@@ -1,9 +1,11 @@
 #ifndef TENSORSCRIPT_IR_BASIC_BLOCK_H
 #define TENSORSCRIPT_IR_BASIC_BLOCK_H
 
-#include <list>
+#include <iterator>
 #include <string>
+#include <vector>
 
+#include "tensorscript/ir/instructions.h"
 #include "tensorscript/ir/value.h"
 #include "tensorscript/ir/visitor.h"
 
@@ -13,12 +15,107 @@ namespace ir {
 class context;
 class function;
 class instruction;
+class basic_block;
+
+/* Instruction list */
+// intrusive list of the instructions of a block. the links are stored in
+// the instructions, so insertion and removal are O(1) and the position of
+// an instruction is known without a search.
+class inst_list {
+ public:
+  class iterator {
+   public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef instruction* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef instruction* const* pointer;
+    typedef instruction* reference;
+
+    iterator() : list_(nullptr), inst_(nullptr) {}
+    iterator(const inst_list* list, instruction* inst)
+        : list_(list), inst_(inst) {}
+    instruction* operator*() const { return inst_; }
+    iterator& operator++() {
+      inst_ = inst_->get_next();
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator result = *this;
+      ++*this;
+      return result;
+    }
+    // decrementing end() yields the last instruction
+    iterator& operator--() {
+      inst_ = inst_ ? inst_->get_prev() : list_->tail_;
+      return *this;
+    }
+    iterator operator--(int) {
+      iterator result = *this;
+      --*this;
+      return result;
+    }
+    bool operator==(const iterator& other) const {
+      return inst_ == other.inst_ && list_ == other.list_;
+    }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+    const inst_list* get_list() const { return list_; }
+
+   private:
+    const inst_list* list_;
+    instruction* inst_;
+  };
+  typedef iterator const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef reverse_iterator const_reverse_iterator;
+
+ public:
+  inst_list(basic_block* parent)
+      : parent_(parent),
+        head_(nullptr),
+        tail_(nullptr),
+        size_(0),
+        order_valid_(true) {}
+  inst_list(const inst_list&) = delete;
+  inst_list& operator=(const inst_list&) = delete;
+
+  basic_block* get_parent() const { return parent_; }
+  iterator begin() const { return iterator(this, head_); }
+  iterator end() const { return iterator(this, nullptr); }
+  reverse_iterator rbegin() const { return reverse_iterator(end()); }
+  reverse_iterator rend() const { return reverse_iterator(begin()); }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  instruction* front() const { return head_; }
+  instruction* back() const { return tail_; }
+  // position of an instruction of this list
+  iterator iterator_to(instruction* i) const { return iterator(this, i); }
+
+  // insert before pos
+  iterator insert(iterator pos, instruction* i);
+  void push_back(instruction* i) { insert(end(), i); }
+  iterator erase(iterator pos);
+  void remove(instruction* i) { erase(iterator_to(i)); }
+
+  // true if a precedes b; both must be in this list. ordering numbers are
+  // recomputed lazily after insertions.
+  bool comes_before(const instruction* a, const instruction* b);
+
+ private:
+  void renumber();
+
+ private:
+  basic_block* parent_;
+  instruction* head_;
+  instruction* tail_;
+  size_t size_;
+  bool order_valid_;
+};
 
 /* Basic Block */
 class basic_block : public value {
  public:
   // instruction iterator types
-  typedef std::list<instruction*> inst_list_t;
+  typedef inst_list inst_list_t;
   typedef inst_list_t::iterator iterator;
   typedef inst_list_t::const_iterator const_iterator;
   typedef inst_list_t::reverse_iterator reverse_iterator;
@@ -39,6 +136,7 @@ class basic_block : public value {
   // get instruction list
   inst_list_t& get_inst_list() { return inst_list_; }
   void erase(instruction* i) { inst_list_.remove(i); }
+  iterator iterator_to(instruction* i) { return inst_list_.iterator_to(i); }
 
   // instruction iterator functions
   inline iterator begin() { return inst_list_.begin(); }
@@ -62,6 +160,8 @@ class basic_block : public value {
   const std::vector<basic_block*>& get_predecessors() const { return preds_; }
   const std::vector<basic_block*>& get_successors() const { return succs_; }
   void add_predecessor(basic_block* pred);
+  // drops one edge from pred, e.g., after its terminator was retargeted
+  void remove_predecessor(basic_block* pred);
 
   // factory functions
   static basic_block* create(context& ctx, const std::string& name,
@@ -0,0 +1,72 @@
+#ifndef TENSORSCRIPT_IR_BYTECODE_H
+#define TENSORSCRIPT_IR_BYTECODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tensorscript {
+namespace ir {
+
+class context;
+class module;
+class function;
+class type;
+class value;
+
+// binary serialization of an ir::module.
+//
+// layout: a header (magic, version, module name), the type table, the
+// module-level tables (allocs, globals, metadata) and a function table
+// holding the byte range of every function body. bodies are decoded on
+// demand, so a reader over a memory-mapped file only touches the functions
+// it materializes. integers are LEB128-encoded; constants are encoded at
+// their uses and re-uniqued in the destination context.
+const uint32_t bytecode_version = 1;
+
+void write_bytecode(module& mod, std::ostream& os);
+
+class bytecode_reader {
+  struct function_entry {
+    function* fn;
+    size_t offset;
+    size_t size;
+    bool materialized;
+  };
+
+ private:
+  bytecode_reader(const char* data, size_t size, void* mapping);
+  void materialize(function_entry& entry);
+
+ public:
+  // read from memory; the buffer must outlive the reader
+  static std::unique_ptr<bytecode_reader> create(const char* data,
+                                                 size_t size);
+  // memory-map a file; it stays mapped as long as the reader exists
+  static std::unique_ptr<bytecode_reader> open(const std::string& path);
+  ~bytecode_reader();
+  // decode the module; functions are declared but their bodies are only
+  // decoded by materialize(). the module must outlive the reader.
+  std::unique_ptr<module> parse_module(context& ctx);
+  bool is_materialized(function* fn) const;
+  void materialize(function* fn);
+  void materialize_all();
+
+ private:
+  const char* data_;
+  size_t size_;
+  void* mapping_;
+  std::vector<type*> types_;
+  std::vector<value*> globals_;
+  std::vector<function_entry> functions_;
+  std::map<function*, size_t> function_ids_;
+};
+
+}  // namespace ir
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_IR_BYTECODE_H
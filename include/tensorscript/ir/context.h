@@ -14,7 +14,9 @@ class context_impl;
 /* Context */
 class context {
  public:
-  context();
+  // a thread-safe context can be shared by several compile jobs: types
+  // and constants are uniqued under per-shard locks
+  explicit context(bool thread_safe = false);
 
  public:
   std::shared_ptr<context_impl> p_impl;
@@ -1,9 +1,14 @@
 #ifndef TENSORSCRIPT_IR_CONTEXT_IMPL_H
 #define TENSORSCRIPT_IR_CONTEXT_IMPL_H
 
-#include <map>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
 
 #include "tensorscript/ir/type.h"
+#include "tensorscript/tools/arena.h"
+#include "tensorscript/tools/sharded_map.h"
 
 namespace tensorscript {
 namespace ir {
@@ -13,30 +18,77 @@ class constant;
 class constant_int;
 class constant_fp;
 class undef_value;
+class make_range;
+class make_range_sta;
+
+// hash of the keys of uniqued types and constants
+struct context_key_hash {
+  template <class T>
+  size_t operator()(const std::pair<type*, T>& key) const {
+    return tools::hash_combine(std::hash<type*>()(key.first),
+                               std::hash<T>()(key.second));
+  }
+
+  size_t operator()(const std::pair<type*, type::tile_shapes_t>& key) const {
+    size_t result = std::hash<type*>()(key.first);
+    for (unsigned shape : key.second)
+      result = tools::hash_combine(result, std::hash<unsigned>()(shape));
+    return result;
+  }
+};
 
 /* Context impl */
 class context_impl {
  public:
   // constructors
-  context_impl(context& ctx);
+  context_impl(context& ctx, bool thread_safe);
+  // storage of every type and value created in this context
+  void* allocate(size_t size, size_t align, void (*finalizer)(void*));
+  void cancel(void* ptr);
+
+ private:
+  void* allocate_local(size_t size, size_t align);
 
  public:
+  // when set, the uniquing tables and the arena may be accessed by several
+  // threads at once. threads then allocate from chunks of the arena they
+  // own, and only take the lock of the arena to get a new chunk
+  const bool thread_safe;
+  // identifies the context in the chunks of threads, unlike its address
+  const uint64_t id;
+  tools::arena arena;
+  std::mutex arena_mutex;
   // primitive types
   type void_ty, label_ty, half_ty, float_ty, double_ty;
   // derived types
   integer_type int1_ty, int8_ty, int16_ty, int32_ty, int64_ty, int128_ty;
+  // uniqued types and constants. an object that loses a creation race
+  // between threads is not used but stays in the arena
   // Pointer types
-  std::map<std::pair<type*, unsigned>, pointer_type*> ptr_tys;
-  std::map<std::pair<type*, type::tile_shapes_t>, tile_type*> tile_tys;
+  tools::sharded_map<std::pair<type*, unsigned>, pointer_type*,
+                     context_key_hash, false>
+      ptr_tys;
+  tools::sharded_map<std::pair<type*, type::tile_shapes_t>, tile_type*,
+                     context_key_hash, false>
+      tile_tys;
   // Int constants
-  std::map<std::pair<type*, uint64_t>, constant_int*> int_constants_;
-  // Float constants
-  std::map<std::pair<type*, double>, constant_fp*> fp_constants_;
+  tools::sharded_map<std::pair<type*, uint64_t>, constant_int*,
+                     context_key_hash, false>
+      int_constants_;
+  // Float constants, keyed by their bit pattern
+  tools::sharded_map<std::pair<type*, uint64_t>, constant_fp*,
+                     context_key_hash, false>
+      fp_constants_;
   // undef values
-  std::map<type*, undef_value*> uv_constants_;
+  tools::sharded_map<type*, undef_value*, std::hash<type*>, false>
+      uv_constants_;
+  // static ranges
+  tools::sharded_map<make_range*, make_range_sta*, std::hash<make_range*>,
+                     false>
+      range_constants_;
 };
 
 }  // namespace ir
 }  // namespace tensorscript
 
-#endif  // TENSORSCRIPT_IR_CONTEXT_IMPL_H
\ No newline at end of file
+#endif  // TENSORSCRIPT_IR_CONTEXT_IMPL_H
@@ -34,7 +34,17 @@ class argument : public value {
 };
 
 /* Attribute */
-enum attribute_kind_t { readonly, writeonly, noalias, aligned, multiple_of };
+// multiple_of, max_contiguous and max_value are hints for the compiler and
+// are not forwarded to LLVM
+enum attribute_kind_t {
+  readonly,
+  writeonly,
+  noalias,
+  aligned,
+  multiple_of,
+  max_contiguous,
+  max_value
+};
 
 class attribute {
  public:
@@ -50,7 +60,10 @@ class attribute {
 
   unsigned get_value() const { return value_; }
 
-  bool is_llvm_attr() const { return kind_ != multiple_of; }
+  bool is_llvm_attr() const {
+    return kind_ != multiple_of && kind_ != max_contiguous &&
+           kind_ != max_value;
+  }
 
   std::string repr() const {
     switch (kind_) {
@@ -63,7 +76,11 @@ class attribute {
       case aligned:
         return ".aligned(" + std::to_string(value_) + ")";
       case multiple_of:
-        return ".readonly";
+        return ".multiple_of(" + std::to_string(value_) + ")";
+      case max_contiguous:
+        return ".max_contiguous(" + std::to_string(value_) + ")";
+      case max_value:
+        return ".max_value(" + std::to_string(value_) + ")";
       default:
         break;
     }
@@ -103,6 +120,8 @@ class function : public global_object {
   // blocks
   const blocks_t& blocks() { return blocks_; }
   void insert_block(basic_block* block, basic_block* next = nullptr);
+  // unlinks a block; its instructions must no longer be used
+  void erase_block(basic_block* block);
 
   // attributes
   void add_attr(unsigned arg_id, attribute attr) {
@@ -11,8 +11,10 @@
 #include "tensorscript/ir/value.h"
 #include "tensorscript/ir/visitor.h"
 
-#define _TRITON_DEFINE_CLONE(name) \
-  ir::instruction* clone_impl() const { return new name(*this); }
+#define _TRITON_DEFINE_CLONE(name)                      \
+  ir::instruction* clone_impl() const {                 \
+    return new (get_type()->get_context()) name(*this); \
+  }
 
 #define _TRITON_DEFINE_ACCEPT(name) \
   void accept(visitor* v) { v->visit_##name(this); }
@@ -34,6 +36,8 @@ class visitor;
 class result_reference;
 
 class instruction : public user {
+  friend class inst_list;
+
  public:
   virtual std::string repr_impl() const = 0;
 
@@ -51,6 +55,11 @@ class instruction : public user {
   const basic_block* get_parent() const { return parent_; }
   basic_block* get_parent() { return parent_; }
   void erase_from_parent();
+  // neighbors in the parent block
+  instruction* get_prev() const { return prev_; }
+  instruction* get_next() const { return next_; }
+  // true if this instruction precedes other in their common block
+  bool comes_before(const instruction* other) const;
   // helpers
   bool has_tile_result_or_op();
   // repr
@@ -59,13 +68,20 @@ class instruction : public user {
   void set_metadata(ir::metadata::kind_t kind, unsigned value) {
     metadatas_[kind] = value;
   }
-  unsigned get_metadata(ir::metadata::kind_t kind) { return metadatas_[kind]; }
+  // 0 when the instruction has no such metadata
+  unsigned get_metadata(ir::metadata::kind_t kind) const {
+    auto it = metadatas_.find(kind);
+    return it == metadatas_.end() ? 0 : it->second;
+  }
+  const std::map<ir::metadata::kind_t, unsigned>& get_metadatas() const {
+    return metadatas_;
+  }
   // cloning
   ir::instruction* clone() {
     ir::instruction* res = clone_impl();
-    for (auto it = op_begin(); it != op_end(); it++)
-      (*it)->add_use(res);
     res->parent_ = nullptr;
+    res->prev_ = nullptr;
+    res->next_ = nullptr;
     return res;
   }
   // instruction id
@@ -73,6 +89,10 @@ class instruction : public user {
 
  private:
   basic_block* parent_;
+  instruction* prev_;
+  instruction* next_;
+  // position in the parent block, maintained by inst_list
+  unsigned order_;
   std::map<ir::metadata::kind_t, unsigned> metadatas_;
   value_id_t id_;
 };
@@ -94,6 +114,8 @@ class phi_node : public instruction {
   basic_block* get_incoming_block(unsigned i) { return blocks_[i]; }
   unsigned get_num_incoming() { return get_num_operands(); }
   void add_incoming(value* v, basic_block* block);
+  // removes the i-th incoming value; the following ones are shifted down
+  void remove_incoming(unsigned i);
 
   // Type
   void set_type(type* ty) { ty_ = ty; }
@@ -594,6 +616,10 @@ class get_program_id_inst : public builtin_inst {
   static instruction* create(context& ctx, unsigned axis,
                              const std::string& name = "",
                              instruction* next = nullptr);
+  // ty is i32 by default, or i64 for 64-bit indexing
+  static instruction* create(type* ty, unsigned axis,
+                             const std::string& name = "",
+                             instruction* next = nullptr);
   unsigned get_axis() const { return axis_; }
   _TRITON_DEFINE_CLONE(get_program_id_inst)
   _TRITON_DEFINE_ACCEPT(get_program_id_inst)
@@ -614,6 +640,10 @@ class get_num_program_inst : public builtin_inst {
   static instruction* create(context& ctx, unsigned axis,
                              const std::string& name = "",
                              instruction* next = nullptr);
+  // ty is i32 by default, or i64 for 64-bit indexing
+  static instruction* create(type* ty, unsigned axis,
+                             const std::string& name = "",
+                             instruction* next = nullptr);
   unsigned get_axis() const { return axis_; }
   _TRITON_DEFINE_CLONE(get_num_program_inst)
   _TRITON_DEFINE_ACCEPT(get_num_program_inst)
@@ -7,7 +7,11 @@ namespace ir {
 /* Metadata */
 class metadata {
  public:
-  enum kind_t { multiple_of };
+  // multiple_of: every element is a multiple of the value
+  // max_contiguous: runs of that many elements along the first axis are
+  // contiguous
+  // max_value: no element exceeds the value
+  enum kind_t { multiple_of, max_contiguous, max_value };
 
  private:
   metadata(kind_t kind, unsigned value);
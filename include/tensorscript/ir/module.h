@@ -99,6 +99,9 @@ class module {
   void add_metadata(const std::string& name, md_pair_t x) {
     metadatas_[name] = x;
   }
+  const std::map<std::string, md_pair_t>& get_metadatas() const {
+    return metadatas_;
+  }
 
  private:
   std::string name_;
@@ -2,6 +2,7 @@
 #define TENSORSCRIPT_IR_TYPE_H
 
 #include <cassert>
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -50,6 +51,10 @@ class type {
 
   // destructor
   virtual ~type() {}
+  // derived types are allocated in the arena of their context
+  static void* operator new(std::size_t size, context& ctx);
+  static void* operator new(std::size_t size) = delete;
+  static void operator delete(void* ptr, context& ctx);
 
   // accessors
   context& get_context() const { return ctx_; }
@@ -163,6 +168,9 @@ class type {
   id_t id_;
 
  protected:
+  // arena-allocated types are never deleted individually; the virtual
+  // destructors still need a deallocation function to refer to
+  static void operator delete(void*) {}
   contained_tys_vec_t contained_tys_;
 };
 
@@ -1,6 +1,8 @@
 #ifndef TENSORSCRIPT_IR_VALUE_H
 #define TENSORSCRIPT_IR_VALUE_H
 
+#include <cstddef>
+#include <iterator>
 #include <set>
 #include <string>
 #include <vector>
@@ -8,25 +10,130 @@
 namespace tensorscript {
 namespace ir {
 
+class context;
 class type;
 class use;
+class value;
 class user;
 class visitor;
 
+//===----------------------------------------------------------------------===//
+//                               use class
+//===----------------------------------------------------------------------===//
+
+// operand slot of a user. the uses of a value form an intrusive
+// doubly-linked list, so uses are added and removed in constant time.
+class use {
+  friend class value;
+  friend class user;
+
+ private:
+  void add_to_list(use** head) {
+    next_ = *head;
+    if (next_)
+      next_->prev_ = &next_;
+    prev_ = head;
+    *head = this;
+  }
+
+  void remove_from_list() {
+    *prev_ = next_;
+    if (next_)
+      next_->prev_ = prev_;
+  }
+
+ public:
+  use() : val_(nullptr), user_(nullptr), next_(nullptr), prev_(nullptr) {}
+  use(const use&) = delete;
+  use& operator=(const use&) = delete;
+  // accessors
+  value* get() const { return val_; }
+  user* get_user() const { return user_; }
+  use* get_next() const { return next_; }
+  unsigned get_operand_no() const;
+  // point the slot to another value
+  void set(value* v);
+
+ private:
+  value* val_;
+  user* user_;
+  use* next_;
+  use** prev_;
+};
+
 //===----------------------------------------------------------------------===//
 //                               value class
 //===----------------------------------------------------------------------===//
 
 class value {
+  friend class use;
+
+ public:
+  // users of a value; a user appears once per operand slot reading it
+  class user_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef user* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef user* const* pointer;
+    typedef user* reference;
+
+    explicit user_iterator(use* u = nullptr) : use_(u) {}
+    user* operator*() const { return use_->get_user(); }
+    user_iterator& operator++() {
+      use_ = use_->get_next();
+      return *this;
+    }
+    user_iterator operator++(int) {
+      user_iterator result = *this;
+      ++*this;
+      return result;
+    }
+    bool operator==(const user_iterator& other) const {
+      return use_ == other.use_;
+    }
+    bool operator!=(const user_iterator& other) const {
+      return use_ != other.use_;
+    }
+    use* get_use() const { return use_; }
+
+   private:
+    use* use_;
+  };
+
+  class user_range {
+   public:
+    explicit user_range(use* head) : head_(head) {}
+    user_iterator begin() const { return user_iterator(head_); }
+    user_iterator end() const { return user_iterator(); }
+    bool empty() const { return head_ == nullptr; }
+
+   private:
+    use* head_;
+  };
+
  public:
   // constructor
   value(type* ty, const std::string& name = "");
+  // copies do not inherit the uses of the original
+  value(const value& other);
   virtual ~value() {}
+  // values are allocated in the arena of their context and released
+  // together with it
+  static void* operator new(std::size_t size, context& ctx);
+  static void* operator new(std::size_t size) = delete;
+  static void operator delete(void* ptr, context& ctx);
   // uses
-  void add_use(user* arg);
-  unsigned erase_use(user* arg);
-  const std::set<user*>& get_users() { return users_; }
-  virtual void replace_all_uses_with(value* target);
+  use* use_begin() const { return uses_; }
+  user_range get_users() const { return user_range(uses_); }
+  bool has_uses() const { return uses_ != nullptr; }
+  unsigned get_num_uses() const;
+  void replace_all_uses_with(value* target);
+  // uniqued constants are shared by every module of their context, possibly
+  // compiled by different threads. they do not track their uses, which would
+  // mix the users of all those modules: their use lists stay empty
+  bool is_shared() const { return shared_; }
+  void set_shared() { shared_ = true; }
   // name
   void set_name(const std::string& name);
   const std::string& get_name() const { return name_; }
@@ -36,10 +143,14 @@ class value {
 
  private:
   std::string name_;
+  use* uses_;
+  bool shared_;
 
  protected:
+  // arena-allocated values are never deleted individually; the virtual
+  // destructors still need a deallocation function to refer to
+  static void operator delete(void*) {}
   type* ty_;
-  std::set<user*> users_;
 };
 
 //===----------------------------------------------------------------------===//
@@ -47,46 +158,108 @@ class value {
 //===----------------------------------------------------------------------===//
 
 class user : public value {
+  friend class use;
+
  public:
-  typedef std::vector<value*> ops_t;
-  typedef ops_t::iterator op_iterator;
-  typedef ops_t::const_iterator const_op_iterator;
+  // operands, viewed as values
+  class op_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef value* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef value* const* pointer;
+    typedef value* reference;
+
+    explicit op_iterator(use* u = nullptr) : use_(u) {}
+    value* operator*() const { return use_->get(); }
+    op_iterator& operator++() {
+      ++use_;
+      return *this;
+    }
+    op_iterator operator++(int) {
+      op_iterator result = *this;
+      ++use_;
+      return result;
+    }
+    op_iterator operator+(difference_type n) const {
+      return op_iterator(use_ + n);
+    }
+    difference_type operator-(const op_iterator& other) const {
+      return use_ - other.use_;
+    }
+    bool operator==(const op_iterator& other) const {
+      return use_ == other.use_;
+    }
+    bool operator!=(const op_iterator& other) const {
+      return use_ != other.use_;
+    }
+    use* get_use() const { return use_; }
+
+   private:
+    use* use_;
+  };
+  typedef op_iterator const_op_iterator;
+
+  class ops_t {
+   public:
+    ops_t(use* begin, use* end) : begin_(begin), end_(end) {}
+    op_iterator begin() const { return op_iterator(begin_); }
+    op_iterator end() const { return op_iterator(end_); }
+    size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+    value* operator[](size_t i) const { return begin_[i].get(); }
+
+   private:
+    use* begin_;
+    use* end_;
+  };
+
+ private:
+  // most instructions have few operands; they are stored inline
+  static const unsigned num_inline_ops = 3;
+  void init_ops(unsigned size);
+  void resize_storage(unsigned size);
 
  protected:
   void resize_ops(unsigned num_ops) {
-    ops_.resize(num_ops + num_hidden_);
+    resize_storage(num_ops + num_hidden_);
     num_ops_ = num_ops;
   }
   void resize_hidden(unsigned num_hidden) {
-    ops_.resize(num_ops_ + num_hidden);
+    resize_storage(num_ops_ + num_hidden);
     num_hidden_ = num_hidden;
   }
 
  public:
   // Constructor
-  user(type* ty, unsigned num_ops, const std::string& name = "")
-      : value(ty, name), ops_(num_ops), num_ops_(num_ops), num_hidden_(0) {}
+  user(type* ty, unsigned num_ops, const std::string& name = "");
+  user(const user& other);
 
   // Operands
-  const ops_t& ops() { return ops_; }
-  op_iterator op_begin() { return ops_.begin(); }
-  op_iterator op_end() { return ops_.end(); }
+  ops_t ops() const { return ops_t(ops_, ops_ + size_); }
+  op_iterator op_begin() const { return op_iterator(ops_); }
+  op_iterator op_end() const { return op_iterator(ops_ + size_); }
+  use& get_operand_use(unsigned i) { return ops_[i]; }
   void set_operand(unsigned i, value* x);
   value* get_operand(unsigned i) const;
   unsigned get_num_operands() const;
   unsigned get_num_hidden() const;
 
   // Utils
-  void replace_all_uses_with(value* target);
   void replace_uses_of_with(value* before, value* after);
+  // unlink every operand, e.g., before the user is erased
+  void drop_all_references();
 
  private:
-  ops_t ops_;
+  use* ops_;
+  unsigned size_;
+  unsigned capacity_;
   unsigned num_ops_;
   unsigned num_hidden_;
+  use inline_ops_[num_inline_ops];
 };
 
 }  // namespace ir
 }  // namespace tensorscript
 
-#endif  // TENSORSCRIPT_IR_VALUE_H
\ No newline at end of file
+#endif  // TENSORSCRIPT_IR_VALUE_H
@@ -0,0 +1,115 @@
+#ifndef TENSORSCRIPT_TOOLS_ARENA_H
+#define TENSORSCRIPT_TOOLS_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace tensorscript {
+namespace tools {
+
+// bump-pointer allocator for objects sharing the lifetime of their owner.
+// memory is carved out of large slabs and is only given back when the arena
+// is destroyed; objects that own resources register a finalizer, and
+// finalizers run in reverse registration order before the slabs are freed.
+// allocation is not thread-safe; registering finalizers in memory provided
+// by the caller and cancelling them are.
+class arena {
+  struct finalizer_t {
+    void (*fn)(void*);
+    void* ptr;
+    finalizer_t* next;
+  };
+
+  char* new_slab(size_t size) {
+    char* slab = static_cast<char*>(::operator new(size));
+    slabs_.push_back(slab);
+    return slab;
+  }
+
+ public:
+  // storage of a finalizer
+  static constexpr size_t finalizer_size = sizeof(finalizer_t);
+  static constexpr size_t finalizer_align = alignof(finalizer_t);
+
+  static char* align_up(char* ptr, size_t align) {
+    uintptr_t x = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<char*>((x + align - 1) & ~uintptr_t(align - 1));
+  }
+
+  explicit arena(size_t slab_size = 64 * 1024)
+      : slab_size_(slab_size),
+        cur_(nullptr),
+        end_(nullptr),
+        finalizers_(nullptr),
+        allocated_(0) {}
+
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+
+  ~arena() {
+    for (finalizer_t* f = finalizers_.load(); f; f = f->next)
+      if (f->fn)
+        f->fn(f->ptr);
+    for (char* slab : slabs_)
+      ::operator delete(slab);
+  }
+
+  void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    allocated_ += size;
+    char* result = cur_ ? align_up(cur_, align) : nullptr;
+    if (result && result + size <= end_) {
+      cur_ = result + size;
+      return result;
+    }
+    // oversized requests get a slab of their own
+    if (size + align > slab_size_ / 4)
+      return align_up(new_slab(size + align), align);
+    cur_ = new_slab(slab_size_);
+    end_ = cur_ + slab_size_;
+    result = align_up(cur_, align);
+    cur_ = result + size;
+    return result;
+  }
+
+  // call fn(ptr) when the arena is destroyed
+  void on_destroy(void* ptr, void (*fn)(void*)) {
+    on_destroy(allocate(finalizer_size, finalizer_align), ptr, fn);
+  }
+
+  // same, with the finalizer stored in mem, e.g., memory of the arena that
+  // the calling thread owns
+  void on_destroy(void* mem, void* ptr, void (*fn)(void*)) {
+    finalizer_t* f = new (mem) finalizer_t{fn, ptr, finalizers_.load()};
+    while (!finalizers_.compare_exchange_weak(f->next, f))
+      ;
+  }
+
+  // drop the finalizer of ptr, e.g., when its constructor threw.
+  // finalizers are never unlinked, so the list can be walked while other
+  // threads register theirs
+  void cancel(void* ptr) {
+    for (finalizer_t* f = finalizers_.load(); f; f = f->next)
+      if (f->ptr == ptr) {
+        f->fn = nullptr;
+        return;
+      }
+  }
+
+  size_t bytes_allocated() const { return allocated_; }
+
+ private:
+  size_t slab_size_;
+  std::vector<char*> slabs_;
+  char* cur_;
+  char* end_;
+  std::atomic<finalizer_t*> finalizers_;
+  size_t allocated_;
+};
+
+}  // namespace tools
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_TOOLS_ARENA_H
@@ -1,33 +1,65 @@
 #ifndef TENSORSCRIPT_TOOLS_THREAD_GRAPH_H
 #define TENSORSCRIPT_TOOLS_THREAD_GRAPH_H
 
+#include <functional>
 #include <map>
-#include <set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace tensorscript {
 namespace tools {
 
-template <class node_t>
-class graph {
-  typedef std::map<node_t, std::set<node_t>> edges_t;
+// hash of graph nodes; pairs (e.g., value and dimension) are combined
+template <class T>
+struct node_hash : std::hash<T> {};
+
+template <class T, class U>
+struct node_hash<std::pair<T, U>> {
+  std::size_t operator()(const std::pair<T, U>& x) const {
+    std::size_t h = node_hash<T>()(x.first);
+    return h ^ (node_hash<U>()(x.second) + 0x9e3779b9 + (h << 6) + (h >> 2));
+  }
+};
 
+// undirected graph whose connected components are maintained with a
+// disjoint-set forest (union by rank, path halving). nodes get dense ids in
+// insertion order, so components are numbered deterministically.
+template <class node_t, class hash_t = node_hash<node_t>>
+class graph {
  public:
   typedef std::map<std::size_t, std::vector<node_t>> cmap_t;
   typedef std::map<node_t, std::size_t> nmap_t;
 
  private:
-  void connected_components_impl(node_t x, std::set<node_t>& nodes,
-                                 nmap_t* nmap, cmap_t* cmap, int id) const {
-    if (nmap)
-      (*nmap)[x] = id;
-    if (cmap)
-      (*cmap)[id].push_back(x);
-    if (nodes.find(x) != nodes.end()) {
-      nodes.erase(x);
-      for (const node_t& y : edges_.at(x))
-        connected_components_impl(y, nodes, nmap, cmap, id);
+  unsigned get_id(const node_t& x) {
+    auto it = ids_.emplace(x, nodes_.size());
+    if (it.second) {
+      parents_.push_back(nodes_.size());
+      ranks_.push_back(0);
+      nodes_.push_back(x);
     }
+    return it.first->second;
+  }
+
+  unsigned find(unsigned x) const {
+    while (parents_[x] != x) {
+      parents_[x] = parents_[parents_[x]];
+      x = parents_[x];
+    }
+    return x;
+  }
+
+  void merge(unsigned x, unsigned y) {
+    x = find(x);
+    y = find(y);
+    if (x == y)
+      return;
+    if (ranks_[x] < ranks_[y])
+      std::swap(x, y);
+    parents_[y] = x;
+    if (ranks_[x] == ranks_[y])
+      ranks_[x]++;
   }
 
  public:
@@ -36,27 +68,35 @@ class graph {
       cmap->clear();
     if (nmap)
       nmap->clear();
-    std::set<node_t> nodes = nodes_;
-    unsigned id = 0;
-    while (!nodes.empty())
-      connected_components_impl(*nodes.begin(), nodes, nmap, cmap, id++);
+    // components are numbered by their first inserted node
+    std::vector<std::size_t> component(nodes_.size(), nodes_.size());
+    std::size_t num_components = 0;
+    for (unsigned i = 0; i < nodes_.size(); i++) {
+      std::size_t& id = component[find(i)];
+      if (id == nodes_.size())
+        id = num_components++;
+      if (nmap)
+        (*nmap)[nodes_[i]] = id;
+      if (cmap)
+        (*cmap)[id].push_back(nodes_[i]);
+    }
   }
 
-  void add_edge(node_t x, node_t y) {
-    nodes_.insert(x);
-    nodes_.insert(y);
-    edges_[x].insert(y);
-    edges_[y].insert(x);
-  }
+  void add_edge(node_t x, node_t y) { merge(get_id(x), get_id(y)); }
 
   void clear() {
+    ids_.clear();
     nodes_.clear();
-    edges_.clear();
+    parents_.clear();
+    ranks_.clear();
   }
 
  private:
-  std::set<node_t> nodes_;
-  edges_t edges_;
+  std::unordered_map<node_t, unsigned, hash_t> ids_;
+  std::vector<node_t> nodes_;
+  // path halving only shortcuts the forest
+  mutable std::vector<unsigned> parents_;
+  std::vector<unsigned> ranks_;
 };
 
 }  // namespace tools
@@ -0,0 +1,135 @@
+#ifndef TENSORSCRIPT_TOOLS_SHARDED_MAP_H
+#define TENSORSCRIPT_TOOLS_SHARDED_MAP_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <unordered_map>
+
+namespace tensorscript {
+namespace tools {
+
+inline std::size_t hash_combine(std::size_t seed, std::size_t h) {
+  return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// read-mostly associative cache split into independently locked shards.
+// lookups only take a shared lock on a single shard; values are created
+// without holding any lock and inserted under the exclusive lock of their
+// shard.
+// shards are ordered maps, or hash tables using hash_t when ordered is
+// false. a map that is not thread-safe takes no lock at all.
+template <class key_t, class value_t, class hash_t = std::hash<key_t>,
+          bool ordered = true, std::size_t num_shards = 16>
+class sharded_map {
+  typedef typename std::conditional<
+      ordered, std::map<key_t, value_t>,
+      std::unordered_map<key_t, value_t, hash_t>>::type storage_t;
+
+  struct shard_t {
+    mutable std::shared_mutex mutex;
+    storage_t map;
+  };
+
+  shard_t& shard(const key_t& key) {
+    std::size_t h = hash_t()(key);
+    return shards_[(h ^ (h >> 16)) % num_shards];
+  }
+
+  std::shared_lock<std::shared_mutex> read_lock(const shard_t& s) const {
+    std::shared_lock<std::shared_mutex> lock(s.mutex, std::defer_lock);
+    if (thread_safe_)
+      lock.lock();
+    return lock;
+  }
+
+  std::unique_lock<std::shared_mutex> write_lock(const shard_t& s) const {
+    std::unique_lock<std::shared_mutex> lock(s.mutex, std::defer_lock);
+    if (thread_safe_)
+      lock.lock();
+    return lock;
+  }
+
+ public:
+  explicit sharded_map(bool thread_safe = true) : thread_safe_(thread_safe) {}
+
+  sharded_map(const sharded_map&) = delete;
+  sharded_map& operator=(const sharded_map&) = delete;
+
+  bool find(const key_t& key, value_t& result) {
+    shard_t& s = shard(key);
+    auto lock = read_lock(s);
+    auto it = s.map.find(key);
+    if (it == s.map.end())
+      return false;
+    result = it->second;
+    return true;
+  }
+
+  template <class create_fn_t>
+  value_t get_or_create(const key_t& key, const create_fn_t& create) {
+    return get_or_create(key, create, [](const value_t&) {});
+  }
+
+  // threads racing on the same key may all create a value; the first one
+  // inserted is returned to every caller and the others are disposed of
+  template <class create_fn_t, class dispose_fn_t>
+  value_t get_or_create(const key_t& key, const create_fn_t& create,
+                        const dispose_fn_t& dispose) {
+    value_t result;
+    if (find(key, result))
+      return result;
+    // create() may throw; only insert once it succeeded
+    result = create();
+    value_t winner;
+    {
+      shard_t& s = shard(key);
+      auto lock = write_lock(s);
+      auto inserted = s.map.try_emplace(key, result);
+      if (inserted.second)
+        return result;
+      winner = inserted.first->second;
+    }
+    dispose(result);
+    return winner;
+  }
+
+  void insert(const key_t& key, const value_t& value) {
+    shard_t& s = shard(key);
+    auto lock = write_lock(s);
+    s.map[key] = value;
+  }
+
+  std::size_t size() const {
+    std::size_t result = 0;
+    for (const shard_t& s : shards_) {
+      auto lock = read_lock(s);
+      result += s.map.size();
+    }
+    return result;
+  }
+
+  // apply fn to every value and empty the map
+  void clear(const std::function<void(value_t&)>& fn = nullptr) {
+    for (shard_t& s : shards_) {
+      auto lock = write_lock(s);
+      if (fn)
+        for (auto& x : s.map)
+          fn(x.second);
+      s.map.clear();
+    }
+  }
+
+ private:
+  bool thread_safe_;
+  std::array<shard_t, num_shards> shards_;
+};
+
+}  // namespace tools
+}  // namespace tensorscript
+
+#endif  // TENSORSCRIPT_TOOLS_SHARDED_MAP_H
@@ -1,98 +1,314 @@
 #ifndef TENSORSCRIPT_TOOLS_THREAD_POOL_H
 #define TENSORSCRIPT_TOOLS_THREAD_POOL_H
 
-#include <vector>
-#include <queue>
-#include <memory>
-#include <thread>
-#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <future>
+#include <deque>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tensorscript {
+namespace tools {
 
-class ThreadPool {
-public:
-    ThreadPool(size_t);
-    template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args)
-        -> std::future<typename std::result_of<F(Args...)>::type>;
-    ~ThreadPool();
-private:
-    // need to keep track of threads so we can join them
-    std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
-
-    // synchronization
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
+/* ------------------------ */
+//         Executor         //
+/* ------------------------ */
+
+// abstract executor. the host backend, parallel compilation and host
+// copies submit their work here, so an application can plug in its own
+// scheduler with set_executor().
+class executor {
+ public:
+  typedef std::function<void()> task_t;
+
+ public:
+  virtual ~executor() {}
+  virtual void submit(task_t task) = 0;
+  // run one pending task on the calling thread, if any.
+  // used by waiting threads to help instead of blocking.
+  virtual bool run_pending() { return false; }
+  virtual size_t num_threads() const = 0;
 };
 
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false)
-{
-    for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
-            {
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-        );
-}
+/* ------------------------ */
+//       Thread Pool        //
+/* ------------------------ */
 
-// add new work item to the pool
-template<class F, class... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args)
-    -> std::future<typename std::result_of<F(Args...)>::type>
-{
-    using return_type = typename std::result_of<F(Args...)>::type;
+// work-stealing thread pool. every worker owns a deque: it pushes and pops
+// at the back, idle workers steal from the front of the others. tasks
+// submitted from outside the pool are distributed round-robin.
+class thread_pool : public executor {
+  struct worker_queue {
+    std::mutex mutex;
+    std::deque<task_t> tasks;
+  };
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
+  // identity of the calling thread, when it is a worker
+  static thread_pool*& current_pool() {
+    static thread_local thread_pool* pool = nullptr;
+    return pool;
+  }
 
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+  static size_t& current_index() {
+    static thread_local size_t index = 0;
+    return index;
+  }
+
+  bool pop(size_t id, task_t& task) {
+    worker_queue& q = *queues_[id];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+      return false;
+    task = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+  // skips queues locked by another thread unless block is set
+  bool steal(size_t id, task_t& task, bool block) {
+    worker_queue& q = *queues_[id];
+    std::unique_lock<std::mutex> lock(q.mutex, std::defer_lock);
+    if (block)
+      lock.lock();
+    else if (!lock.try_lock())
+      return false;
+    if (q.tasks.empty())
+      return false;
+    task = std::move(q.tasks.front());
+    q.tasks.pop_front();
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool acquire(size_t self, task_t& task, bool block = false) {
+    size_t n = queues_.size();
+    if (self < n && pop(self, task))
+      return true;
+    for (size_t i = 1; i <= n; i++)
+      if (steal((self + i) % n, task, block))
+        return true;
+    return false;
+  }
+
+  void worker_loop(size_t id) {
+    current_pool() = this;
+    current_index() = id;
+    task_t task;
+    while (true) {
+      // queued_ only counts tasks still in a deque, so a worker goes to
+      // sleep once a blocking pass finds nothing
+      if (acquire(id, task) || acquire(id, task, true)) {
+        task();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      sleep_cv_.wait(lock, [this] {
+        return stop_.load(std::memory_order_relaxed) ||
+               queued_.load(std::memory_order_relaxed) > 0;
+      });
+      if (stop_.load(std::memory_order_relaxed) &&
+          queued_.load(std::memory_order_relaxed) == 0)
+        return;
+    }
+  }
 
-        tasks.emplace([task](){ (*task)(); });
+ public:
+  explicit thread_pool(
+      size_t num_threads = std::max(1u, std::thread::hardware_concurrency()))
+      : next_(0), queued_(0), stop_(false) {
+    for (size_t i = 0; i < num_threads; i++)
+      queues_.emplace_back(new worker_queue());
+    for (size_t i = 0; i < num_threads; i++)
+      workers_.emplace_back([this, i] { worker_loop(i); });
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (std::thread& worker : workers_)
+      worker.join();
+  }
+
+  void submit(task_t task) override {
+    if (stop_.load(std::memory_order_relaxed))
+      throw std::runtime_error("submit on stopped thread_pool");
+    // workers push on their own deque, other threads round-robin
+    size_t id = current_pool() == this
+                    ? current_index()
+                    : next_.fetch_add(1, std::memory_order_relaxed) %
+                          queues_.size();
+    {
+      worker_queue& q = *queues_[id];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+      queued_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // a worker checking queued_ either sees the task or is already waiting
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
     }
-    condition.notify_one();
+    sleep_cv_.notify_one();
+  }
+
+  bool run_pending() override {
+    task_t task;
+    size_t self = current_pool() == this ? current_index() : queues_.size();
+    if (!acquire(self, task))
+      return false;
+    task();
+    return true;
+  }
+
+  size_t num_threads() const override { return workers_.size(); }
+
+  // submit a callable and get a future on its result
+  template <class F, class... Args>
+  auto enqueue(F&& f, Args&&... args)
+      -> std::future<typename std::result_of<F(Args...)>::type> {
+    using return_type = typename std::result_of<F(Args...)>::type;
+    auto task = std::make_shared<std::packaged_task<return_type()>>(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    std::future<return_type> res = task->get_future();
+    submit([task]() { (*task)(); });
     return res;
+  }
+
+ private:
+  std::vector<std::unique_ptr<worker_queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<size_t> next_;
+  std::atomic<size_t> queued_;
+  // sleeping workers
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  std::atomic<bool> stop_;
+};
+
+/* ------------------------ */
+//     Default Executor     //
+/* ------------------------ */
+
+inline executor*& executor_override() {
+  static executor* exec = nullptr;
+  return exec;
 }
 
-// the destructor joins all threads
-inline ThreadPool::~ThreadPool()
-{
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        stop = true;
+inline thread_pool& default_thread_pool() {
+  static thread_pool pool;
+  return pool;
+}
+
+// executor used by the library; the shared thread pool unless the
+// application provided its own
+inline executor* get_executor() {
+  if (executor* exec = executor_override())
+    return exec;
+  return &default_thread_pool();
+}
+
+inline void set_executor(executor* exec) { executor_override() = exec; }
+
+/* ------------------------ */
+//        Task Group        //
+/* ------------------------ */
+
+// set of tasks that can be joined. the joining thread helps executing
+// pending tasks, so groups can be nested inside tasks of the same pool.
+class task_group {
+  void join() {
+    while (pending_.load(std::memory_order_acquire) > 0) {
+      if (exec_->run_pending())
+        continue;
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_for(lock, std::chrono::microseconds(100), [this] {
+        return pending_.load(std::memory_order_acquire) == 0;
+      });
     }
-    condition.notify_all();
-    for(std::thread &worker: workers)
-        worker.join();
+  }
+
+ public:
+  explicit task_group(executor* exec = get_executor())
+      : exec_(exec), pending_(0) {}
+
+  ~task_group() {
+    join();
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+
+  template <class F>
+  void run(F&& f) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    exec_->submit([this, f = std::forward<F>(f)]() mutable {
+      try {
+        f();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_)
+          error_ = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        cv_.notify_all();
+    });
+  }
+
+  // block until every task finished; rethrows the first exception
+  void wait() {
+    join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_) {
+      std::exception_ptr error = error_;
+      error_ = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  executor* exec_;
+  std::atomic<size_t> pending_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::exception_ptr error_;
+};
+
+/* ------------------------ */
+//       Parallel For       //
+/* ------------------------ */
+
+// calls fn(lo, hi) on chunks of [begin, end) of at most grain iterations
+template <class F>
+void parallel_for(size_t begin, size_t end, size_t grain, const F& fn,
+                  executor* exec = get_executor()) {
+  if (begin >= end)
+    return;
+  grain = std::max<size_t>(grain, 1);
+  if (end - begin <= grain || exec->num_threads() <= 1) {
+    fn(begin, end);
+    return;
+  }
+  task_group group(exec);
+  for (size_t lo = begin + grain; lo < end; lo += grain) {
+    size_t hi = std::min(lo + grain, end);
+    group.run([&fn, lo, hi]() { fn(lo, hi); });
+  }
+  // the calling thread takes the first chunk
+  fn(begin, std::min(begin + grain, end));
+  group.wait();
 }
 
+}  // namespace tools
+}  // namespace tensorscript
+
 #endif  // TENSORSCRIPT_TOOLS_THREAD_POOL_H
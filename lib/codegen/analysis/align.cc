@@ -45,6 +45,19 @@ inline T add_to_cache(ir::value* i, T value, std::map<ir::value*, T>& map) {
   return map[i] = value;
 }
 
+// hint attached to an instruction as metadata or to an argument as an
+// attribute; 0 when absent
+inline unsigned get_hint(ir::value* v, ir::metadata::kind_t md,
+                         ir::attribute_kind_t attr) {
+  if (auto* x = dynamic_cast<ir::instruction*>(v))
+    return x->get_metadata(md);
+  if (auto* x = dynamic_cast<ir::argument*>(v))
+    for (const ir::attribute& a : x->get_parent()->get_attributes(x))
+      if (a.get_kind() == attr)
+        return a.get_value();
+  return 0;
+}
+
 /*
  * is constant
  */
@@ -325,8 +338,12 @@ std::vector<unsigned> align::populate_max_contiguous_default(ir::value* v) {
     return add_to_cache(v, {shapes[0]}, max_contiguous_);
   if (dynamic_cast<ir::make_range_sta*>(v))
     return add_to_cache(v, {shapes[0]}, max_contiguous_);
-  return add_to_cache(v, std::vector<unsigned>(shapes.size(), 1),
-                      max_contiguous_);
+  std::vector<unsigned> result(shapes.size(), 1);
+  // user hint, e.g., on a loaded tile of offsets
+  unsigned hint = get_hint(v, ir::metadata::max_contiguous, ir::max_contiguous);
+  if (hint > 0)
+    result[0] = std::min(hint, shapes[0]);
+  return add_to_cache(v, result, max_contiguous_);
 }
 
 std::vector<unsigned> align::populate_max_contiguous(ir::value* v) {
@@ -448,18 +465,22 @@ std::vector<unsigned> align::populate_starting_multiple_default(ir::value* v) {
       return add_to_cache(x, {multiple_of}, starting_multiple_);
   }
   if (auto* x = dynamic_cast<ir::argument*>(v)) {
+    // the strongest attribute wins, e.g., when a specialized kernel adds
+    // aligned(16) to a pointer already aligned(4)
     std::set<ir::attribute> attributes = x->get_parent()->get_attributes(x);
+    unsigned result = 0;
     for (auto attr : attributes) {
-      if (attr.get_kind() == ir::multiple_of) {
-        return add_to_cache(x, {attr.get_value()}, starting_multiple_);
-      }
+      if (attr.get_kind() == ir::multiple_of)
+        result = std::max(result, attr.get_value());
       if (attr.get_kind() == ir::aligned) {
         ir::type* ty = x->get_type()->get_pointer_element_ty();
         int nbits = ty->get_primitive_size_in_bits();
         int nbytes = nbits / 8;
-        return add_to_cache(x, {attr.get_value() / nbytes}, starting_multiple_);
+        result = std::max(result, attr.get_value() / nbytes);
       }
     }
+    if (result > 0)
+      return add_to_cache(x, {result}, starting_multiple_);
   }
   return add_to_cache(v, {1}, starting_multiple_);
 }
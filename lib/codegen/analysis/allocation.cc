@@ -11,96 +11,73 @@ namespace tensorscript {
 namespace codegen {
 namespace analysis {
 
-void allocation::run(ir::module& mod) {
-  using std::max;
-  using std::min;
-  typedef std::multimap<unsigned, segment> triples_map_type;
-
-  std::vector<shared_layout*> I;
-  for (auto x : liveness_->get())
-    I.push_back(x.first);
-  std::vector<shared_layout*> J = I;
+static size_t align_up(size_t x, size_t align) {
+  return (x + align - 1) / align * align;
+}
 
-  triples_map_type H;
-  H.insert({0, segment{0, INT_MAX}});
+void allocation::run(ir::module& mod) {
+  offsets_.clear();
+  allocated_size_ = 0;
+  live_size_ = 0;
 
   std::vector<shared_layout*> V;
-  std::map<shared_layout*, unsigned> starts;
-  while (!J.empty()) {
-    auto h_it = H.begin();
-    unsigned w = h_it->first;
-    segment xh = h_it->second;
-    H.erase(h_it);
-    auto j_it = std::find_if(J.begin(), J.end(), [&](shared_layout* JJ) {
-      segment xj = liveness_->get(JJ);
-      bool res = xj.intersect(xh);
-      for (auto val : H)
-        res = res && !val.second.intersect(xj);
-      return res;
-    });
-    if (j_it != J.end()) {
-      unsigned size = (*j_it)->get_size();
-      segment xj = liveness_->get(*j_it);
-      starts[*j_it] = w;
-      H.insert(
-          {w + size, segment{max(xh.start, xj.start), min(xh.end, xj.end)}});
-      if (xh.start < xj.start)
-        H.insert({w, segment{xh.start, xj.end}});
-      if (xj.end < xh.end)
-        H.insert({w, segment{xj.start, xh.end}});
-      V.push_back(*j_it);
-      J.erase(j_it);
-    }
-  }
-
-  // Build interference graph
-  std::map<shared_layout*, std::set<shared_layout*>> interferences;
-  for (shared_layout* x : V)
-    for (shared_layout* y : V) {
-      if (x == y)
-        continue;
-      unsigned X0 = starts[x], Y0 = starts[y];
-      unsigned NX = x->get_size();
-      unsigned NY = y->get_size();
-      segment XS = {X0, X0 + NX};
-      segment YS = {Y0, Y0 + NY};
-      if (liveness_->get(x).intersect(liveness_->get(y)) && XS.intersect(YS))
-        interferences[x].insert(y);
-    }
+  for (auto x : liveness_->get())
+    V.push_back(x.first);
 
-  // Initialize colors
-  std::map<shared_layout*, int> colors;
-  for (shared_layout* X : V)
-    colors[X] = (X == V[0]) ? 0 : -1;
+  // largest buffers first; ties are broken by live range
+  std::stable_sort(V.begin(), V.end(), [&](shared_layout* x, shared_layout* y) {
+    if (x->get_size() != y->get_size())
+      return x->get_size() > y->get_size();
+    const live_range& xs = liveness_->get(x);
+    const live_range& ys = liveness_->get(y);
+    return std::make_pair(xs.start(), xs.end()) <
+           std::make_pair(ys.start(), ys.end());
+  });
 
-  // First-fit graph coloring
-  std::vector<bool> available(V.size());
+  // best-fit placement
+  std::vector<shared_layout*> placed;
   for (shared_layout* x : V) {
-    // Non-neighboring colors are available
-    std::fill(available.begin(), available.end(), true);
-    for (shared_layout* Y : interferences[x]) {
-      int color = colors[Y];
-      if (color >= 0)
-        available[color] = false;
+    const live_range& xs = liveness_->get(x);
+    size_t size = x->get_size();
+    size_t align = x->get_alignment();
+    // buffers live at the same time as x, by offset
+    std::vector<shared_layout*> live;
+    for (shared_layout* y : placed)
+      if (xs.intersect(liveness_->get(y)))
+        live.push_back(y);
+    std::sort(live.begin(), live.end(),
+              [&](shared_layout* y, shared_layout* z) {
+                return offsets_.at(y) < offsets_.at(z);
+              });
+    // smallest gap that fits x, or the top of the live buffers
+    size_t best = SIZE_MAX;
+    size_t best_gap = SIZE_MAX;
+    size_t top = 0;
+    for (shared_layout* y : live) {
+      size_t begin = align_up(top, align);
+      size_t y_offset = offsets_.at(y);
+      if (y_offset >= begin + size && y_offset - begin < best_gap) {
+        best = begin;
+        best_gap = y_offset - begin;
+      }
+      top = std::max(top, y_offset + y->get_size());
     }
-    // Assigns first available color
-    auto It = std::find(available.begin(), available.end(), true);
-    colors[x] = std::distance(available.begin(), It);
-  }
-
-  // Finalize allocation
-  for (shared_layout* x : V) {
-    unsigned Adj = 0;
-    for (shared_layout* y : interferences[x])
-      Adj = std::max<unsigned>(Adj, starts[y] + y->get_size());
-    offsets_[x] = starts[x] + colors[x] * Adj;
+    if (best == SIZE_MAX)
+      best = align_up(top, align);
+    offsets_[x] = best;
+    allocated_size_ = std::max(allocated_size_, best + size);
+    placed.push_back(x);
   }
 
-  // Save maximum size of induced memory space
-  allocated_size_ = 0;
+  // lower bound: the live set is largest where some live range starts
   for (shared_layout* x : V)
-    allocated_size_ =
-        std::max<size_t>(allocated_size_, starts[x] + x->get_size());
+    for (const segment& s : liveness_->get(x).get_segments()) {
+      size_t size = x->get_size();
+      for (shared_layout* y : V)
+        if (y != x && liveness_->get(y).contains(s.start))
+          size += y->get_size();
+      live_size_ = std::max(live_size_, size);
+    }
 }
 
 }  // namespace analysis
@@ -1,6 +1,7 @@
 #include "tensorscript/codegen/analysis/layout.h"
 
 #include <algorithm>
+#include <climits>
 #include <iostream>
 #include <numeric>
 
@@ -72,6 +73,62 @@ inline bool is_trans(ir::value* v) {
   return false;
 }
 
+// order imposed on a shared buffer by the non-mma dots reading it
+inline bool extract_dot_order(const std::vector<ir::value*>& values,
+                              size_t rank, std::vector<int>& order) {
+  ir::value* dot_a = nullptr;
+  ir::value* dot_b = nullptr;
+  ir::value* hmma_dot_a = nullptr;
+  ir::value* hmma_dot_b = nullptr;
+  for (ir::value* v : values) {
+    extract_dot_use(v, dot_a, 0);
+    extract_dot_use(v, dot_b, 1);
+    extract_hmma_dot_use(v, hmma_dot_a, 0);
+    extract_hmma_dot_use(v, hmma_dot_b, 1);
+  }
+  std::vector<int> col = {0, 1};
+  std::vector<int> row = {1, 0};
+  for (size_t s = 2; s < rank; s++) {
+    col.push_back(s);
+    row.push_back(s);
+  }
+  if (dot_a && !hmma_dot_a) {
+    order = is_trans(dot_a) ? row : col;
+    return true;
+  }
+  if (dot_b && !hmma_dot_b) {
+    order = is_trans(dot_b) ? col : row;
+    return true;
+  }
+  return false;
+}
+
+// dimensions sorted by decreasing contiguity of the largest io pointer
+inline std::vector<int> io_order(const std::vector<ir::value*>& values,
+                                 size_t rank, analysis::align* align) {
+  std::vector<int> order(rank);
+  std::iota(order.begin(), order.end(), 0);
+  std::set<ir::value*> ptr;
+  for (ir::value* v : values)
+    extract_io_use(v, ptr);
+  if (ptr.empty())
+    return order;
+  auto largest =
+      std::max_element(ptr.begin(), ptr.end(), [&](ir::value* x, ir::value* y) {
+        return x->get_type()->get_tile_rank() < y->get_type()->get_tile_rank();
+      });
+  auto max_contiguous = align->contiguous(*largest);
+  std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return max_contiguous[a] > max_contiguous[b];
+  });
+  return order;
+}
+
+// relative cost of a 32-byte global memory sector and of a shared memory
+// access, used to select layouts
+const unsigned global_access_cost = 4;
+const unsigned shared_access_cost = 1;
+
 /* -------------------------------- *
  *          Layout Visitor          *
  * -------------------------------- */
@@ -85,24 +142,9 @@ void layout_visitor::visit_layout(data_layout* layout) { layout->accept(this); }
 data_layout::data_layout(id_t id, const std::vector<int>& axes,
                          const std::vector<unsigned>& shape,
                          const std::vector<ir::value*>& values,
-                         analysis::align* align)
+                         analysis::align* align, const order_t& order)
     : id_(id), axes_(axes), shape_(shape), values_(values) {
-  // io pointer
-  std::set<ir::value*> ptr;
-  for (ir::value* v : values_)
-    extract_io_use(v, ptr);
-  order_.resize(axes_.size());
-  std::iota(order_.begin(), order_.end(), 0);
-  auto largest =
-      std::max_element(ptr.begin(), ptr.end(), [&](ir::value* x, ir::value* y) {
-        return x->get_type()->get_tile_rank() < y->get_type()->get_tile_rank();
-      });
-  if (*largest) {
-    auto max_contiguous = align->contiguous(*largest);
-    std::sort(order_.begin(), order_.end(), [&](unsigned a, unsigned b) {
-      return max_contiguous[a] > max_contiguous[b];
-    });
-  }
+  order_ = order.empty() ? io_order(values_, axes_.size(), align) : order;
 }
 
 size_t data_layout::find_axis(int to_find) const {
@@ -161,8 +203,9 @@ mma884_layout::mma884_layout(size_t num_warps, const std::vector<int>& axes,
 scanline_layout::scanline_layout(size_t num_warps, const std::vector<int>& axes,
                                  const std::vector<unsigned>& shape,
                                  const std::vector<ir::value*>& values,
-                                 analysis::align* align)
-    : data_layout(SCANLINE, axes, shape, values, align) {
+                                 analysis::align* align,
+                                 const std::vector<int>& order)
+    : data_layout(SCANLINE, axes, shape, values, align, order) {
   unsigned size =
       std::accumulate(shape_.begin(), shape_.end(), 1, std::multiplies<int>());
   unsigned num_threads = num_warps * 32;
@@ -248,13 +291,38 @@ void shared_layout::extract_double_bufferable(
     res.reset(new double_buffer_info_t{value_1, value_0, phi});
 }
 
+swizzle_t shared_layout::make_swizzle(const std::vector<unsigned>& shape,
+                                      const std::vector<int>& order,
+                                      size_t elt_bytes) {
+  swizzle_t none{1, 1, 1};
+  if (order.size() < 2 || elt_bytes == 0 || elt_bytes > 16)
+    return none;
+  unsigned cols = shape[order[0]];
+  if (cols & (cols - 1))
+    return none;
+  // vectors are as wide as the widest access, i.e., 16 bytes
+  unsigned vec = std::min<unsigned>(16 / elt_bytes, cols);
+  // rows sharing a 128-byte line of banks share a phase; the phases cycle
+  // through the vectors of such a line
+  unsigned row_bytes = cols * elt_bytes;
+  unsigned per_phase = std::max<unsigned>(128 / row_bytes, 1);
+  unsigned max_phase = std::min<unsigned>(cols / vec, 128 / (vec * elt_bytes));
+  if (max_phase <= 1)
+    return none;
+  return swizzle_t{vec, per_phase, max_phase};
+}
+
 shared_layout::shared_layout(const data_layout* arg,
                              const std::vector<int>& axes,
                              const std::vector<unsigned>& shape,
                              const std::vector<ir::value*>& values,
                              ir::type* ty, analysis::align* align)
-    : data_layout(SHARED, axes, shape, values, align), ty_(ty) {
+    : data_layout(SHARED, axes, shape, values, align),
+      pad_(0),
+      swizzle_{1, 1, 1},
+      ty_(ty) {
   size_ = 0;
+  size_t elt_bytes = ty_->get_primitive_size_in_bits() / 8;
 
   // double-buffering
   for (ir::value* v : values)
@@ -264,50 +332,44 @@ shared_layout::shared_layout(const data_layout* arg,
   std::vector<int> arg_order = arg ? arg->get_order() : std::vector<int>{0};
   order_ = arg_order;
 
-  ir::value* dot_a = nullptr;
-  ir::value* dot_b = nullptr;
   ir::value* hmma_dot_a = nullptr;
   ir::value* hmma_dot_b = nullptr;
   for (ir::value* v : values) {
-    extract_dot_use(v, dot_a, 0);
-    extract_dot_use(v, dot_b, 1);
     extract_hmma_dot_use(v, hmma_dot_a, 0);
     extract_hmma_dot_use(v, hmma_dot_b, 1);
   }
 
   // non-mma ordering
-  std::vector<int> col = {0, 1};
-  std::vector<int> row = {1, 0};
-  for (size_t s = 2; s < get_rank(); s++) {
-    col.push_back(s);
-    row.push_back(s);
-  }
-  bool is_nonhmma_dot_a = dot_a && !hmma_dot_a;
-  bool is_nonhmma_dot_b = dot_b && !hmma_dot_b;
-  if (is_nonhmma_dot_a)
-    order_ = is_trans(dot_a) ? row : col;
-  else if (is_nonhmma_dot_b)
-    order_ = is_trans(dot_b) ? col : row;
-
-  // padding
-  size_t pad = 0;
+  extract_dot_order(values, get_rank(), order_);
+
+  // padding or swizzling. mma operands are addressed directly by the
+  // tensor core code and keep their padding; buffers written and read in
+  // different orders, e.g., transposed dot operands, are swizzled when the
+  // shape allows it
   if (hmma_dot_a) {
     bool row = is_trans(hmma_dot_a) ^ order_[0] != 0;
-    pad = 24 - shape_[row ? 0 : 1] % 32;
+    pad_ = 24 - shape_[row ? 0 : 1] % 32;
   } else if (hmma_dot_b) {
     bool row = is_trans(hmma_dot_b) ^ order_[0] != 0;
-    pad = 24 - shape_[row ? 1 : 0] % 32;
+    pad_ = 24 - shape_[row ? 1 : 0] % 32;
   } else if (order_ != arg_order) {
-    pad = 4;
+    swizzle_ = make_swizzle(shape_, order_, elt_bytes);
+    if (!swizzle_.enabled())
+      pad_ = 4;
   }
-  shape_[order_[0]] += pad;
+  shape_[order_[0]] += pad_;
 
   // size
-  size_ = ty_->get_primitive_size_in_bits() / 8;
+  size_ = elt_bytes;
   for (auto s : shape_)
     size_ *= s;
   if (double_buffer_)
     size_ *= 2;
+
+  // alignment: largest power of two, up to 16 bytes, dividing the size of
+  // a contiguous row. this also aligns the second half of double buffers
+  size_t row_size = elt_bytes * shape_[order_[0]];
+  alignment_ = std::max<size_t>(std::min<size_t>(row_size & -row_size, 16), 1);
 }
 
 /* -------------------------------- *
@@ -345,6 +407,72 @@ void layouts::make_graph(ir::instruction* i) {
     }
 }
 
+unsigned layouts::io_cost(ir::value* ptr, int leading) {
+  // 32-byte sectors touched; accesses are coalesced over the elements that
+  // are contiguous along the leading axis
+  ir::type* ty = ptr->get_type();
+  ir::type* elt_ty = ty->get_scalar_ty()->get_pointer_element_ty();
+  unsigned elt_bytes =
+      std::max<unsigned>(elt_ty->get_primitive_size_in_bits() / 8, 1);
+  unsigned run = std::min<unsigned>(align_->contiguous(ptr)[leading],
+                                    std::max<unsigned>(32 / elt_bytes, 1));
+  run = std::max<unsigned>(run, 1);
+  unsigned num_elements = ty->get_tile_num_elements();
+  return global_access_cost * ((num_elements + run - 1) / run);
+}
+
+unsigned layouts::conversion_cost(ir::value* v, int leading) {
+  // copies to shared buffers read by non-mma dots are only vectorized when
+  // the buffer has the same leading axis
+  unsigned result = 0;
+  for (ir::user* u : v->get_users()) {
+    auto* cts = dynamic_cast<ir::copy_to_shared_inst*>(u);
+    if (!cts || groups_.at(cts) == groups_.at(v))
+      continue;
+    std::vector<int> order;
+    size_t rank = cts->get_type()->get_tile_rank();
+    if (!extract_dot_order(values_.at(groups_.at(cts)), rank, order))
+      continue;
+    const auto& shapes = cts->get_type()->get_tile_shapes();
+    unsigned num_elements = cts->get_type()->get_tile_num_elements();
+    unsigned vec = order[0] == leading ? std::min<unsigned>(4, shapes[leading])
+                                       : 1;
+    result += shared_access_cost * (num_elements / vec);
+  }
+  return result;
+}
+
+std::vector<int> layouts::select_order(size_t id,
+                                       const std::vector<ir::value*>& values,
+                                       const std::vector<int>& default_order) {
+  std::set<ir::value*> ptrs;
+  for (ir::value* v : values)
+    extract_io_use(v, ptrs);
+  size_t rank = default_order.size();
+  // candidates: each axis leads, the others keep their default order. ties
+  // are broken in favor of the default order
+  std::vector<int> best = default_order;
+  unsigned best_cost = UINT_MAX;
+  for (size_t k = 0; k < std::max<size_t>(rank, 1); k++) {
+    std::vector<int> order = default_order;
+    if (k < rank)
+      std::rotate(order.begin(), order.begin() + k, order.begin() + k + 1);
+    int leading = order.empty() ? 0 : order[0];
+    unsigned cost = 0;
+    for (ir::value* ptr : ptrs)
+      if (ptr->get_type()->get_tile_rank() == rank)
+        cost += io_cost(ptr, leading);
+    for (ir::value* v : values)
+      cost += conversion_cost(v, leading);
+    if (cost < best_cost) {
+      best = order;
+      best_cost = cost;
+    }
+  }
+  costs_[id] = best_cost;
+  return best;
+}
+
 void layouts::create(size_t id, const std::vector<ir::value*>& values) {
   auto it_hmma_c = std::find_if(values.begin(), values.end(), &is_hmma_c);
   auto cmp = [](ir::value* x, ir::value* y) {
@@ -370,9 +498,12 @@ void layouts::create(size_t id, const std::vector<ir::value*>& values) {
     layouts_[id] =
         new shared_layout(get(arg), axes, shapes, values,
                           largest->get_type()->get_scalar_ty(), align_);
-  } else
+  } else {
+    std::vector<int> order =
+        select_order(id, values, io_order(values, axes.size(), align_));
     layouts_[id] =
-        new scanline_layout(num_warps_, axes, shapes, values, align_);
+        new scanline_layout(num_warps_, axes, shapes, values, align_, order);
+  }
 }
 
 void layouts::run(ir::module& mod) {
@@ -384,6 +515,7 @@ void layouts::run(ir::module& mod) {
   graph_.connected_components(&values_, &groups_);
 
   // create layouts
+  costs_.clear();
   for (const auto& x : values_)
     create(x.first, x.second);
 
@@ -1,53 +1,165 @@
 #include "tensorscript/codegen/analysis/liveness.h"
 
+#include <algorithm>
 #include <climits>
 #include <iostream>
 
 #include "tensorscript/codegen/analysis/layout.h"
-#include "tensorscript/ir/cfg.h"
+#include "tensorscript/ir/basic_block.h"
 #include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
 #include "tensorscript/ir/module.h"
 
 namespace tensorscript {
 namespace codegen {
 namespace analysis {
 
-void liveness::run(ir::module& mod) {
-  intervals_.clear();
+/* Live range */
+
+void live_range::add(segment s) {
+  if (s.start >= s.end)
+    return;
+  auto it = std::lower_bound(
+      segments_.begin(), segments_.end(), s,
+      [](const segment& x, const segment& y) { return x.start < y.start; });
+  // merge with the touching neighbors
+  if (it != segments_.begin() && std::prev(it)->end >= s.start)
+    --it;
+  auto last = it;
+  while (last != segments_.end() && last->start <= s.end) {
+    s.start = std::min(s.start, last->start);
+    s.end = std::max(s.end, last->end);
+    ++last;
+  }
+  it = segments_.erase(it, last);
+  segments_.insert(it, s);
+}
+
+bool live_range::contains(slot_index idx) const {
+  for (const segment& s : segments_)
+    if (s.contains(idx))
+      return true;
+  return false;
+}
+
+bool live_range::intersect(const live_range& other) const {
+  auto x = segments_.begin();
+  auto y = other.segments_.begin();
+  while (x != segments_.end() && y != other.segments_.end()) {
+    if (x->start < y->end && y->start < x->end)
+      return true;
+    if (x->end <= y->end)
+      ++x;
+    else
+      ++y;
+  }
+  return false;
+}
+
+/* Liveness */
+
+void liveness::run(ir::function* fn, slot_index& index) {
+  typedef std::set<ir::value*> values_t;
+  auto tracked = [&](ir::value* v) { return layout_of_.count(v) > 0; };
+  const std::vector<ir::basic_block*>& blocks = fn->blocks();
+
+  // number instructions
+  std::map<ir::instruction*, slot_index> slots;
+  std::map<ir::basic_block*, segment> block_slots;
+  for (ir::basic_block* block : blocks) {
+    slot_index begin = index;
+    for (ir::instruction* instr : block->get_inst_list())
+      slots[instr] = index++;
+    block_slots[block] = segment{begin, index};
+  }
 
-  // Assigns index to each instruction
-  std::map<ir::value*, slot_index> indices;
-  for (ir::function* fn : mod.get_function_list()) {
-    slot_index index = 0;
-    for (ir::basic_block* block : fn->blocks())
-      for (ir::instruction* instr : block->get_inst_list()) {
-        index += 1;
-        indices.insert({instr, index});
+  // live-in and live-out sets; phi operands are used at the end of the
+  // corresponding predecessor
+  std::map<ir::basic_block*, values_t> live_in, live_out;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+      ir::basic_block* block = *it;
+      values_t out;
+      for (ir::basic_block* succ : block->get_successors()) {
+        const values_t& in = live_in[succ];
+        out.insert(in.begin(), in.end());
+        for (ir::instruction* instr : succ->get_inst_list()) {
+          auto* phi = dynamic_cast<ir::phi_node*>(instr);
+          if (!phi)
+            break;
+          for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+            if (phi->get_incoming_block(n) == block &&
+                tracked(phi->get_incoming_value(n)))
+              out.insert(phi->get_incoming_value(n));
+        }
       }
+      values_t in = out;
+      auto& insts = block->get_inst_list();
+      for (auto i = insts.rbegin(); i != insts.rend(); ++i) {
+        in.erase(*i);
+        if (dynamic_cast<ir::phi_node*>(*i))
+          continue;
+        for (ir::value* op : (*i)->ops())
+          if (tracked(op))
+            in.insert(op);
+      }
+      if (in != live_in[block] || out != live_out[block]) {
+        live_in[block] = std::move(in);
+        live_out[block] = std::move(out);
+        changed = true;
+      }
+    }
   }
 
-  // create live intervals
+  // live ranges, block by block
+  for (ir::basic_block* block : blocks) {
+    segment range = block_slots.at(block);
+    std::map<ir::value*, slot_index> ends;
+    for (ir::value* v : live_out[block])
+      ends[v] = range.end;
+    auto& insts = block->get_inst_list();
+    for (auto i = insts.rbegin(); i != insts.rend(); ++i) {
+      slot_index slot = slots.at(*i);
+      if (tracked(*i)) {
+        // dead definitions still occupy their own slot
+        auto it = ends.find(*i);
+        slot_index end = it != ends.end() ? it->second : slot + 1;
+        intervals_[layout_of_.at(*i)].add(segment{slot, end});
+        if (it != ends.end())
+          ends.erase(it);
+      }
+      if (dynamic_cast<ir::phi_node*>(*i))
+        continue;
+      for (ir::value* op : (*i)->ops())
+        if (tracked(op) && !ends.count(op))
+          ends[op] = slot + 1;
+    }
+    // live-in values
+    for (auto& x : ends)
+      intervals_[layout_of_.at(x.first)].add(segment{range.start, x.second});
+  }
+}
+
+void liveness::run(ir::module& mod) {
+  intervals_.clear();
+  layout_of_.clear();
+
+  // values stored in shared memory
   for (auto& x : layouts_->get_all()) {
     shared_layout* layout = x.second->to_shared();
     if (!layout)
       continue;
-    // users
-    std::set<ir::user*> users;
-    for (ir::value* v : layout->get_values()) {
-      for (ir::user* u : v->get_users())
-        users.insert(u);
-    }
-    // compute intervals
-    unsigned start = INT32_MAX;
+    intervals_[layout];
     for (ir::value* v : layout->get_values())
-      if (indices.find(v) != indices.end())
-        start = std::min(start, indices.at(v));
-    unsigned end = 0;
-    for (ir::user* u : users)
-      if (indices.find(u) != indices.end())
-        end = std::max(end, indices.at(u));
-    intervals_[layout] = segment{start, end};
+      layout_of_[v] = layout;
   }
+
+  // slots are numbered across the whole module
+  slot_index index = 0;
+  for (ir::function* fn : mod.get_function_list())
+    run(fn, index);
 }
 
 }  // namespace analysis
@@ -0,0 +1,308 @@
+#include "tensorscript/codegen/analysis/range.h"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+#include "tensorscript/ir/basic_block.h"
+#include "tensorscript/ir/cfg.h"
+#include "tensorscript/ir/constant.h"
+#include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
+#include "tensorscript/ir/module.h"
+#include "tensorscript/ir/type.h"
+
+namespace tensorscript {
+namespace codegen {
+namespace analysis {
+
+// rounds after which growing phi ranges are widened
+static const unsigned widen_after = 4;
+
+static bool is_int(ir::value* v) {
+  return v->get_type()->get_scalar_ty()->is_integer_ty();
+}
+
+static unsigned bitwidth(ir::type* ty) {
+  return ty->get_scalar_ty()->get_integer_bitwidth();
+}
+
+static range::interval_t join(range::interval_t x, range::interval_t y) {
+  if (x.empty())
+    return y;
+  if (y.empty())
+    return x;
+  return {std::min(x.lo, y.lo), std::max(x.hi, y.hi)};
+}
+
+range::interval_t range::full(ir::type* ty) {
+  unsigned bits = bitwidth(ty);
+  if (bits == 1)
+    return {0, 1};
+  if (bits >= 64)
+    return {INT64_MIN, INT64_MAX};
+  return {-(int64_t(1) << (bits - 1)), (int64_t(1) << (bits - 1)) - 1};
+}
+
+// values leaving the range of their type wrap around
+range::interval_t range::clamp(ir::type* ty, __int128 lo, __int128 hi) {
+  interval_t bounds = full(ty);
+  if (lo < bounds.lo || hi > bounds.hi)
+    return bounds;
+  return {(int64_t)lo, (int64_t)hi};
+}
+
+range::interval_t range::get_or_empty(ir::value* v) {
+  auto it = ranges_.find(v);
+  if (it != ranges_.end())
+    return it->second;
+  // values defined outside of the function body
+  if (!dynamic_cast<ir::instruction*>(v))
+    return compute(v);
+  return {1, 0};
+}
+
+range::interval_t range::compute_binop(ir::binary_operator* x) {
+  ir::type* ty = x->get_type();
+  interval_t a = get_or_empty(x->get_operand(0));
+  interval_t b = get_or_empty(x->get_operand(1));
+  if (a.empty() || b.empty())
+    return {1, 0};
+  __int128 alo = a.lo, ahi = a.hi, blo = b.lo, bhi = b.hi;
+  switch (x->get_op()) {
+    case ir::binary_op_t::Add:
+      return clamp(ty, alo + blo, ahi + bhi);
+    case ir::binary_op_t::Sub:
+      return clamp(ty, alo - bhi, ahi - blo);
+    case ir::binary_op_t::Mul: {
+      __int128 p[4] = {alo * blo, alo * bhi, ahi * blo, ahi * bhi};
+      return clamp(ty, *std::min_element(p, p + 4),
+                   *std::max_element(p, p + 4));
+    }
+    case ir::binary_op_t::SDiv:
+    case ir::binary_op_t::UDiv:
+      if (blo <= 0 || (x->get_op() == ir::binary_op_t::UDiv && alo < 0))
+        break;
+      return clamp(ty, std::min(alo / blo, alo / bhi),
+                   std::max(ahi / blo, ahi / bhi));
+    case ir::binary_op_t::SRem:
+    case ir::binary_op_t::URem:
+      if (blo <= 0)
+        break;
+      if (alo >= 0)
+        return clamp(ty, 0, std::min(ahi, bhi - 1));
+      if (x->get_op() == ir::binary_op_t::SRem)
+        return clamp(ty, -(bhi - 1), bhi - 1);
+      break;
+    case ir::binary_op_t::And:
+      if (alo >= 0 && blo >= 0)
+        return clamp(ty, 0, std::min(ahi, bhi));
+      if (alo >= 0)
+        return clamp(ty, 0, ahi);
+      if (blo >= 0)
+        return clamp(ty, 0, bhi);
+      break;
+    case ir::binary_op_t::Shl:
+      if (blo != bhi || blo < 0 || blo > 62)
+        break;
+      return clamp(ty, alo * (__int128(1) << (int)blo),
+                   ahi * (__int128(1) << (int)blo));
+    case ir::binary_op_t::LShr:
+    case ir::binary_op_t::AShr:
+      if (blo != bhi || blo < 0 || blo > 62 || alo < 0)
+        break;
+      return clamp(ty, alo >> (int)blo, ahi >> (int)blo);
+    default:
+      break;
+  }
+  return full(ty);
+}
+
+range::interval_t range::compute_cmp(ir::cmp_inst* x) {
+  interval_t unknown = {0, 1};
+  if (!is_int(x->get_operand(0)))
+    return unknown;
+  interval_t a = get_or_empty(x->get_operand(0));
+  interval_t b = get_or_empty(x->get_operand(1));
+  if (a.empty() || b.empty())
+    return {1, 0};
+  ir::cmp_pred_t pred = x->get_pred();
+  // unsigned comparisons of non-negative values are signed comparisons
+  bool non_negative = a.lo >= 0 && b.lo >= 0;
+  bool is_true = false, is_false = false;
+  switch (pred) {
+    case ir::ICMP_EQ:
+      is_true = a.lo == a.hi && b.lo == b.hi && a.lo == b.lo;
+      is_false = a.hi < b.lo || b.hi < a.lo;
+      break;
+    case ir::ICMP_NE:
+      is_true = a.hi < b.lo || b.hi < a.lo;
+      is_false = a.lo == a.hi && b.lo == b.hi && a.lo == b.lo;
+      break;
+    case ir::ICMP_ULT:
+    case ir::ICMP_SLT:
+      if (pred == ir::ICMP_ULT && !non_negative)
+        break;
+      is_true = a.hi < b.lo;
+      is_false = a.lo >= b.hi;
+      break;
+    case ir::ICMP_ULE:
+    case ir::ICMP_SLE:
+      if (pred == ir::ICMP_ULE && !non_negative)
+        break;
+      is_true = a.hi <= b.lo;
+      is_false = a.lo > b.hi;
+      break;
+    case ir::ICMP_UGT:
+    case ir::ICMP_SGT:
+      if (pred == ir::ICMP_UGT && !non_negative)
+        break;
+      is_true = a.lo > b.hi;
+      is_false = a.hi <= b.lo;
+      break;
+    case ir::ICMP_UGE:
+    case ir::ICMP_SGE:
+      if (pred == ir::ICMP_UGE && !non_negative)
+        break;
+      is_true = a.lo >= b.hi;
+      is_false = a.hi < b.lo;
+      break;
+    default:
+      break;
+  }
+  if (is_true)
+    return {1, 1};
+  if (is_false)
+    return {0, 0};
+  return unknown;
+}
+
+range::interval_t range::compute_cast(ir::cast_inst* x) {
+  ir::type* ty = x->get_type();
+  ir::value* op = x->get_operand(0);
+  if (!is_int(op))
+    return full(ty);
+  interval_t a = get_or_empty(op);
+  if (a.empty())
+    return a;
+  switch (x->get_op()) {
+    case ir::cast_op_t::SExt:
+    case ir::cast_op_t::Trunc:
+      return clamp(ty, a.lo, a.hi);
+    case ir::cast_op_t::ZExt:
+      if (a.lo >= 0)
+        return clamp(ty, a.lo, a.hi);
+      return clamp(ty, 0, (__int128(1) << bitwidth(op->get_type())) - 1);
+    default:
+      return full(ty);
+  }
+}
+
+range::interval_t range::compute(ir::value* v) {
+  ir::type* ty = v->get_type();
+  interval_t result = full(ty);
+  if (auto* x = dynamic_cast<ir::constant_int*>(v)) {
+    unsigned bits = bitwidth(ty);
+    uint64_t value = x->get_value();
+    if (bits == 1)
+      return {int64_t(value & 1), int64_t(value & 1)};
+    // sign-extend
+    if (bits < 64 && (value >> (bits - 1)) & 1)
+      value |= ~uint64_t(0) << bits;
+    return {(int64_t)value, (int64_t)value};
+  }
+  if (auto* x = dynamic_cast<ir::argument*>(v)) {
+    for (const ir::attribute& attr : x->get_parent()->get_attributes(x))
+      if (attr.get_kind() == ir::max_value)
+        result.hi = std::min<int64_t>(result.hi, attr.get_value());
+    return result;
+  }
+  if (auto* x = dynamic_cast<ir::make_range*>(v))
+    return {(int64_t)x->get_first()->get_value(),
+            (int64_t)x->get_last()->get_value() - 1};
+  if (auto* x = dynamic_cast<ir::make_range_sta*>(v))
+    return {(int64_t)x->get_range()->get_first()->get_value(),
+            (int64_t)x->get_range()->get_last()->get_value() - 1};
+  if (dynamic_cast<ir::splat_inst*>(v) ||
+      dynamic_cast<ir::broadcast_inst*>(v) ||
+      dynamic_cast<ir::reshape_inst*>(v))
+    result = get_or_empty(((ir::instruction*)v)->get_operand(0));
+  else if (auto* x = dynamic_cast<ir::select_inst*>(v))
+    result = join(get_or_empty(x->get_operand(1)),
+                  get_or_empty(x->get_operand(2)));
+  else if (auto* x = dynamic_cast<ir::phi_node*>(v)) {
+    result = {1, 0};
+    for (unsigned n = 0; n < x->get_num_incoming(); n++)
+      result = join(result, get_or_empty(x->get_incoming_value(n)));
+  } else if (auto* x = dynamic_cast<ir::binary_operator*>(v))
+    result = compute_binop(x);
+  else if (auto* x = dynamic_cast<ir::cmp_inst*>(v))
+    result = compute_cmp(x);
+  else if (auto* x = dynamic_cast<ir::cast_inst*>(v))
+    result = compute_cast(x);
+  // user hint
+  if (auto* x = dynamic_cast<ir::instruction*>(v))
+    if (unsigned hint = x->get_metadata(ir::metadata::max_value))
+      result.hi = std::min<int64_t>(result.hi, hint);
+  return result;
+}
+
+void range::run(ir::function* fn) {
+  std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
+  for (unsigned round = 0;; round++) {
+    bool changed = false;
+    for (ir::basic_block* block : rpo)
+      for (ir::instruction* i : block->get_inst_list()) {
+        if (!is_int(i))
+          continue;
+        interval_t current = compute(i);
+        auto it = ranges_.find(i);
+        if (it == ranges_.end()) {
+          if (!current.empty()) {
+            ranges_[i] = current;
+            changed = true;
+          }
+          continue;
+        }
+        interval_t previous = it->second;
+        interval_t next = join(previous, current);
+        if (round >= widen_after) {
+          interval_t bounds = full(i->get_type());
+          if (next.lo < previous.lo)
+            next.lo = bounds.lo;
+          if (next.hi > previous.hi)
+            next.hi = bounds.hi;
+        }
+        if (next != previous) {
+          it->second = next;
+          changed = true;
+        }
+      }
+    if (!changed)
+      break;
+  }
+}
+
+void range::run(ir::module& mod) {
+  ranges_.clear();
+  for (ir::function* fn : mod.get_function_list())
+    run(fn);
+}
+
+range::interval_t range::get(ir::value* v) {
+  if (!is_int(v))
+    throw std::runtime_error("range of a non-integer value");
+  interval_t result = get_or_empty(v);
+  return result.empty() ? full(v->get_type()) : result;
+}
+
+bool range::is_true(ir::value* v) {
+  if (!is_int(v))
+    return false;
+  interval_t result = get(v);
+  return result.lo == 1 && result.hi == 1;
+}
+
+}  // namespace analysis
+}  // namespace codegen
+}  // namespace tensorscript
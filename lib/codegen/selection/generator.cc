@@ -250,13 +250,26 @@ inline bool is_trans(ir::value* v) {
 
 generator::generator(analysis::axes* a_axes, analysis::layouts* layouts,
                      analysis::align* alignment, analysis::allocation* alloc,
-                     target* tgt, unsigned num_warps)
+                     target* tgt, unsigned num_warps, unsigned loop_unroll)
     : a_axes_(a_axes),
       layouts_(layouts),
       alignment_(alignment),
       alloc_(alloc),
       tgt_(tgt),
-      num_warps_(num_warps) {}
+      num_warps_(num_warps),
+      loop_unroll_(loop_unroll) {}
+
+template <class F>
+void generator::for_each(ir::value* x, const F& fn) {
+  if (!x->get_type()->is_tile_ty())
+    return fn(indices_t());
+  else {
+    //    if(tmap_.find(x) == tmap_.end())
+    //      tmap_[x] = machine_layouts_.at(layouts_->get(x))->create(x);
+    if (auto* dt = dynamic_cast<distributed_tile*>(tmap_.at(x)))
+      dt->for_each(fn);
+  }
+}
 
 void generator::visit_value(ir::value* v) {
   if (!seen_.insert(v).second)
@@ -277,13 +290,135 @@ void generator::visit_value(ir::value* v) {
   if (phi && !current->empty() && current->getFirstNonPHI())
     builder_->SetInsertPoint(&*current->getFirstNonPHI());
   // visit user
-  if (auto* usr = dynamic_cast<ir::user*>(v))
+  if (inst && is_loop_candidate(inst))
+    emit_loop(inst);
+  else if (auto* usr = dynamic_cast<ir::user*>(v))
     usr->accept(this);
   // revert insert point
   if (phi && !current->empty() && current->getFirstNonPHI())
     builder_->SetInsertPoint(current);
 }
 
+bool generator::is_loop_candidate(ir::instruction* x) {
+  if (loop_unroll_ == 0 || !x->get_type()->is_tile_ty())
+    return false;
+  if (!dynamic_cast<ir::binary_operator*>(x) &&
+      !dynamic_cast<ir::icmp_inst*>(x) && !dynamic_cast<ir::fcmp_inst*>(x) &&
+      !dynamic_cast<ir::cast_inst*>(x) && !dynamic_cast<ir::select_inst*>(x) &&
+      !dynamic_cast<ir::sqrt_inst*>(x) &&
+      !dynamic_cast<ir::getelementptr_inst*>(x))
+    return false;
+  auto* result = dynamic_cast<distributed_tile*>(tmap_.at(x));
+  if (!result || result->size() <= loop_unroll_)
+    return false;
+  // operands must enumerate their elements in the same order
+  for (ir::value* op : x->ops()) {
+    if (!op->get_type()->is_tile_ty())
+      continue;
+    if (layouts_->get(op) != layouts_->get(x) ||
+        op->get_type()->get_tile_shapes() != x->get_type()->get_tile_shapes())
+      return false;
+    if (!dynamic_cast<distributed_tile*>(tmap_.at(op)))
+      return false;
+  }
+  return true;
+}
+
+Value* generator::get_storage(distributed_tile* tile) {
+  // tiles computed by a loop already live in memory
+  if (Value* storage = tile->get_storage())
+    return storage;
+  // allocate in the entry block
+  Function* fn = builder_->GetInsertBlock()->getParent();
+  BasicBlock& entry = fn->getEntryBlock();
+  Builder entry_builder(&entry, entry.begin());
+  Value* storage = entry_builder.CreateAlloca(tile->get_ty(),
+                                              builder_->getInt32(tile->size()));
+  // spill register values. the copy is not cached: the next user may not
+  // be dominated by this point
+  for (unsigned i = 0; i < tile->size(); i++) {
+    Value* ptr = builder_->CreateGEP(storage, builder_->getInt32(i));
+    builder_->CreateStore(tile->get_value(tile->get_ordered_indices(i)), ptr);
+  }
+  return storage;
+}
+
+Value* generator::emit_elementwise(ir::instruction* x,
+                                   const std::vector<Value*>& ops) {
+  if (auto* binop = dynamic_cast<ir::binary_operator*>(x))
+    return builder_->CreateBinOp(llvm_op(binop->get_op()), ops[0], ops[1]);
+  if (auto* icmp = dynamic_cast<ir::icmp_inst*>(x))
+    return builder_->CreateICmp(llvm_pred(icmp->get_pred()), ops[0], ops[1]);
+  if (auto* fcmp = dynamic_cast<ir::fcmp_inst*>(x))
+    return builder_->CreateFCmp(llvm_pred(fcmp->get_pred()), ops[0], ops[1]);
+  if (auto* cast = dynamic_cast<ir::cast_inst*>(x)) {
+    Type* dst_ty = llvm_type(cast->get_type()->get_scalar_ty(), *ctx_);
+    return builder_->CreateCast(llvm_op(cast->get_op()), ops[0], dst_ty);
+  }
+  if (dynamic_cast<ir::select_inst*>(x))
+    return builder_->CreateSelect(ops[0], ops[1], ops[2]);
+  if (dynamic_cast<ir::sqrt_inst*>(x)) {
+    Value* sqrt = Intrinsic::getDeclaration(mod_, Intrinsic::sqrt,
+                                            {ops[0]->getType()});
+    return builder_->CreateCall(sqrt, {ops[0]});
+  }
+  if (auto* gep = dynamic_cast<ir::getelementptr_inst*>(x)) {
+    Type* source_ty =
+        llvm_type(gep->get_source_elt_ty()->get_scalar_ty(), *ctx_);
+    std::vector<Value*> idx_vals(ops.begin() + 1, ops.end());
+    return builder_->CreateGEP(source_ty, ops[0], idx_vals);
+  }
+  throw std::runtime_error("unsupported element-wise instruction");
+}
+
+void generator::emit_loop(ir::instruction* x) {
+  distributed_tile* result = (distributed_tile*)tmap_.at(x);
+  unsigned size = result->size();
+  unsigned num_ops = x->get_num_operands();
+  // operands: memory for tiles, registers for scalars
+  std::vector<Value*> storages(num_ops, nullptr);
+  for (unsigned n = 0; n < num_ops; n++) {
+    ir::value* op = x->get_operand(n);
+    if (op->get_type()->is_tile_ty())
+      storages[n] = get_storage((distributed_tile*)tmap_.at(op));
+  }
+  Function* fn = builder_->GetInsertBlock()->getParent();
+  Builder entry_builder(&fn->getEntryBlock(), fn->getEntryBlock().begin());
+  Value* dst = entry_builder.CreateAlloca(result->get_ty(),
+                                          builder_->getInt32(size));
+  result->set_storage(dst);
+  // body for element i
+  auto body = [&](Value* i) {
+    std::vector<Value*> ops(num_ops);
+    for (unsigned n = 0; n < num_ops; n++)
+      ops[n] = storages[n]
+                   ? builder_->CreateLoad(builder_->CreateGEP(storages[n], i))
+                   : vmap_.at(x->get_operand(n));
+    builder_->CreateStore(emit_elementwise(x, ops),
+                          builder_->CreateGEP(dst, i));
+  };
+  // main loop, unrolled by loop_unroll_
+  unsigned num_iters = size / loop_unroll_;
+  BasicBlock* preheader = builder_->GetInsertBlock();
+  BasicBlock* loop = BasicBlock::Create(*ctx_, "tile_loop", fn);
+  BasicBlock* exit = BasicBlock::Create(*ctx_, "tile_loop_exit", fn);
+  builder_->CreateBr(loop);
+  builder_->SetInsertPoint(loop);
+  PHINode* iv = builder_->CreatePHI(builder_->getInt32Ty(), 2);
+  iv->addIncoming(builder_->getInt32(0), preheader);
+  for (unsigned u = 0; u < loop_unroll_; u++)
+    body(builder_->CreateAdd(iv, builder_->getInt32(u)));
+  Value* next = builder_->CreateAdd(iv, builder_->getInt32(loop_unroll_));
+  iv->addIncoming(next, builder_->GetInsertBlock());
+  Value* last = builder_->getInt32(num_iters * loop_unroll_);
+  Value* cond = builder_->CreateICmpULT(next, last);
+  builder_->CreateCondBr(cond, loop, exit);
+  builder_->SetInsertPoint(exit);
+  // remainder
+  for (unsigned i = num_iters * loop_unroll_; i < size; i++)
+    body(builder_->getInt32(i));
+}
+
 void generator::visit_phi_node(ir::phi_node* phi) {
   Type* ty = llvm_type(phi->get_type()->get_scalar_ty(), *ctx_);
   unsigned num_ops = phi->get_num_operands();
@@ -627,13 +762,16 @@ void generator::visit_downcast_inst(ir::downcast_inst* x) {
 void generator::visit_get_program_id_inst(ir::get_program_id_inst* pid) {
   Module* module = builder_->GetInsertBlock()->getModule();
   Value* ret = tgt_->get_block_id(module, *builder_, pid->get_axis());
-  vmap_[pid] = ret;
+  // 64-bit program ids are extended from the 32-bit hardware registers
+  vmap_[pid] =
+      builder_->CreateZExtOrTrunc(ret, llvm_type(pid->get_type(), *ctx_));
 }
 
 void generator::visit_get_num_program_inst(ir::get_num_program_inst* np) {
   Module* module = builder_->GetInsertBlock()->getModule();
   Value* ret = tgt_->get_num_blocks(module, *builder_, np->get_axis());
-  vmap_[np] = ret;
+  vmap_[np] =
+      builder_->CreateZExtOrTrunc(ret, llvm_type(np->get_type(), *ctx_));
 }
 
 void generator::visit_atomic_cas_inst(ir::atomic_cas_inst* cas) {
@@ -948,6 +1086,7 @@ void generator::visit_trans_inst(ir::trans_inst* trans) {
   shared_tile* out = new shared_tile(
       in->get_ty(), in->get_shapes(), in->get_order(), in->get_pointer(),
       *builder_, in->get_offset(), trans->get_perm());
+  out->set_swizzle(in->get_swizzle());
   tmap_[trans] = out;
 }
 
@@ -1304,9 +1443,16 @@ void generator::visit_function(ir::function* fn) {
     std::vector<Type*> fn_args_ty;
     for (unsigned i = 0; i < fn_ty->getNumParams(); i++)
       fn_args_ty.push_back(fn_ty->getParamType(i));
-    fn_args_ty.push_back(builder_->getInt32Ty());
-    fn_args_ty.push_back(builder_->getInt32Ty());
-    fn_args_ty.push_back(builder_->getInt32Ty());
+    // grid coordinates are as wide as the program ids
+    Type* grid_ty = builder_->getInt32Ty();
+    for (ir::basic_block* block : fn->blocks())
+      for (ir::instruction* i : block->get_inst_list())
+        if (dynamic_cast<ir::get_program_id_inst*>(i) &&
+            i->get_type()->is_integer_ty(64))
+          grid_ty = builder_->getInt64Ty();
+    fn_args_ty.push_back(grid_ty);
+    fn_args_ty.push_back(grid_ty);
+    fn_args_ty.push_back(grid_ty);
     fn_ty = FunctionType::get(fn_ret_ty, fn_args_ty, false);
   }
   Function* ret =
@@ -1369,18 +1515,6 @@ void generator::visit_basic_block(ir::basic_block* block) {
 
 void generator::visit_argument(ir::argument* arg) {}
 
-void generator::for_each(ir::value* x,
-                         const std::function<void(indices_t)>& fn) {
-  if (!x->get_type()->is_tile_ty())
-    return fn({});
-  else {
-    //    if(tmap_.find(x) == tmap_.end())
-    //      tmap_[x] = machine_layouts_.at(layouts_->get(x))->create(x);
-    if (auto* dt = dynamic_cast<distributed_tile*>(tmap_.at(x)))
-      dt->for_each(fn);
-  }
-}
-
 Value* generator::get_value(ir::value* x, const indices_t& idx) {
   if (x->get_type()->is_tile_ty())
     return tmap_.at(x)->get_value(idx);
@@ -1440,6 +1574,8 @@ void generator::finalize_phi_node(ir::phi_node* phi) {
   for (unsigned n = 0; n < phi->get_num_incoming(); n++) {
     ir::basic_block* inc_block = phi->get_incoming_block(n);
     BasicBlock* llvm_inc_block = (BasicBlock*)vmap_.at(inc_block);
+    // values kept in memory are loaded at the end of the incoming block
+    builder_->SetInsertPoint(llvm_inc_block->getTerminator());
     for_each(phi, [&](indices_t idx) {
       PHINode* llvm_phi = (PHINode*)get_value(phi, idx);
       Value* llvm_inc_val = get_value(phi->get_incoming_value(n), idx);
@@ -137,8 +137,11 @@ tile* machine_shared_layout::create(ir::value* v) {
   else if (double_buffer && v == double_buffer->first)
     ptr = pre_ptr_;
   // create tile
-  return new shared_tile(ty, layout_->get_shape(), layout_->get_order(), ptr,
-                         *builder_, offset);
+  shared_tile* result = new shared_tile(ty, layout_->get_shape(),
+                                        layout_->get_order(), ptr, *builder_,
+                                        offset);
+  result->set_swizzle(layout_->get_swizzle());
+  return result;
 }
 
 machine_distributed_layout::machine_distributed_layout(
@@ -12,21 +12,34 @@ using namespace llvm;
 
 /* Distributed Tile */
 void distributed_tile::init_indices() {
-  std::vector<size_t> id(axes_.size(), 0);
+  size_t rank = axes_.size();
+  // position of every axis value
+  positions_.resize(rank);
+  for (size_t d = 0; d < rank; d++) {
+    const std::vector<Value*>& values = axes_[d].values;
+    for (size_t i = 0; i < values.size(); i++)
+      positions_[d].emplace(values[i], i);
+  }
+  // strides of the linear index; order_[0] varies fastest
+  strides_.resize(rank);
+  strides_[order_[0]] = 1;
+  for (size_t k = 1; k < rank; k++)
+    strides_[order_[k]] =
+        strides_[order_[k - 1]] * axes_[order_[k - 1]].values.size();
   // build
+  std::vector<size_t> id(rank, 0);
   size_t k = 0;
   while (true) {
-    indices_t current;
-    for (size_t d = 0; d < id.size(); d++)
-      current.push_back(axes_[d].values[id[d]]);
-    size_t sz = indices_.size();
-    indices_[current] = sz;
-    values_[current] = nullptr;
+    indices_t current(rank);
+    for (size_t d = 0; d < rank; d++)
+      current[d] = axes_[d].values[id[d]];
     ordered_indices_.push_back(current);
     id[order_[0]]++;
     while (id[order_[k]] == axes_[order_[k]].values.size()) {
-      if (k == id.size() - 1)
+      if (k == id.size() - 1) {
+        values_.assign(ordered_indices_.size(), nullptr);
         return;
+      }
       id[order_[k++]] = 0;
       id[order_[k]]++;
     }
@@ -38,56 +51,38 @@ distributed_tile::distributed_tile(Type* ty, const shapes_t& shapes,
                                    const std::vector<int>& order,
                                    const axes_t& axes,
                                    llvm::IRBuilder<>& builder)
-    : tile(ty, shapes), axes_(axes), order_(order), builder_(builder) {
+    : tile(ty, shapes),
+      axes_(axes),
+      order_(order),
+      storage_(nullptr),
+      builder_(builder) {
   init_indices();
 }
 
-void distributed_tile::set_value(indices_t idx, Value* x) {
+void distributed_tile::set_value(const indices_t& idx, Value* x) {
   assert(x->getType() == ty_ && "cannot set a value of different type");
-  Value*& result = values_[idx];
+  Value*& result = values_[get_linear_index(idx)];
   assert(!result && "value cannot be set twice");
   result = x;
 }
 
-Value* distributed_tile::get_value(indices_t idx) {
-  Value* result = values_.at(idx);
+Value* distributed_tile::get_value(const indices_t& idx) {
+  unsigned linear = get_linear_index(idx);
+  Value* result = values_[linear];
+  if (!result && storage_) {
+    Value* ptr = builder_.CreateGEP(storage_, builder_.getInt32(linear));
+    return builder_.CreateLoad(ptr);
+  }
   assert(result && "value has not been set");
   return result;
 }
 
-unsigned distributed_tile::get_linear_index(indices_t idx) {
-  return indices_[idx];
-}
-
-indices_t distributed_tile::get_ordered_indices(unsigned id) {
-  return ordered_indices_.at(id);
-}
-
-void distributed_tile::for_each(std::function<void(indices_t)> fn, int start,
-                                int end) {
-  if (end < 0)
-    end = ordered_indices_.size() + end + 1;
-  for (unsigned i = start; i < end; i++)
-    fn(ordered_indices_[i]);
-}
-
-void distributed_tile::for_each(std::function<void(indices_t)> fn,
-                                std::vector<int> starts,
-                                std::vector<int> sizes) {
-  int rank = sizes.size();
-  int len = 1;
-  for (int s : sizes)
-    len *= s;
-
-  for (int i = 0; i < len; i++) {
-    indices_t idx(rank);
-    int current = i;
-    for (int k = 0; k < rank; k++) {
-      idx[k] = axes_[k].values.at(starts[k] + current % sizes[k]);
-      current = current / sizes[k];
-    }
-    fn(idx);
-  }
+unsigned distributed_tile::get_linear_index(const indices_t& idx) const {
+  assert(idx.size() == positions_.size() && "rank mismatch");
+  unsigned result = 0;
+  for (size_t d = 0; d < idx.size(); d++)
+    result += positions_[d].at(idx[d]) * strides_[d];
+  return result;
 }
 
 /* Shared Tile */
@@ -137,7 +132,20 @@ Value* shared_tile::shared_offset(llvm::IRBuilder<>& builder,
                                   const shapes_t& shapes,
                                   const std::vector<int>& perm,
                                   const std::vector<int>& order,
-                                  indices_t idx) {
+                                  indices_t idx,
+                                  const analysis::swizzle_t& swizzle) {
+  // swizzle the column of the vector along order[0]
+  if (swizzle.enabled() && order.size() > 1) {
+    Value*& col = idx[perm[order[0]]];
+    Value* row = idx[perm[order[1]]];
+    Value* vec = builder.getInt32(swizzle.vec);
+    Value* phase = builder.CreateURem(
+        builder.CreateUDiv(row, builder.getInt32(swizzle.per_phase)),
+        builder.getInt32(swizzle.max_phase));
+    Value* col_vec = builder.CreateXor(builder.CreateUDiv(col, vec), phase);
+    col = builder.CreateAdd(builder.CreateMul(col_vec, vec),
+                            builder.CreateURem(col, vec));
+  }
   // strides
   std::vector<Value*> strides(order.size());
   strides[order[0]] = builder.getInt32(1);
@@ -162,7 +170,8 @@ shared_tile::shared_tile(Type* ty, const shapes_t& shapes,
       builder_(builder),
       offset_(offset),
       vector_size_(1),
-      perm_(perm) {
+      perm_(perm),
+      swizzle_{1, 1, 1} {
   return_vector_ = false;
   if (perm_.empty()) {
     perm_.resize(shapes.size());
@@ -170,9 +179,9 @@ shared_tile::shared_tile(Type* ty, const shapes_t& shapes,
   }
 }
 
-void shared_tile::set_value(indices_t idx, Value* value) {
+void shared_tile::set_value(const indices_t& idx, Value* value) {
   Value* ptr = builder_.CreateGEP(
-      ptr_, shared_offset(builder_, shapes_, perm_, order_, idx));
+      ptr_, shared_offset(builder_, shapes_, perm_, order_, idx, swizzle_));
   unsigned addr_space = ptr->getType()->getPointerAddressSpace();
   ptr = builder_.CreateBitCast(ptr, value->getType()->getPointerTo(addr_space));
   builder_.CreateStore(value, ptr);
@@ -186,9 +195,16 @@ void shared_tile::set_return_mode(bool return_vector) {
   return_vector_ = return_vector;
 }
 
-Value* shared_tile::get_value(indices_t idx) {
+Value* shared_tile::get_value(const indices_t& idx) {
   indices_t non_cst_idx, cst_idx;
-  extract_constant(idx, non_cst_idx, cst_idx);
+  // the swizzle does not distribute over the constant part of the indices;
+  // swizzled tiles are addressed from their base pointer
+  if (swizzle_.enabled()) {
+    non_cst_idx.assign(idx.size(), builder_.getInt32(0));
+    cst_idx = idx;
+  } else {
+    extract_constant(idx, non_cst_idx, cst_idx);
+  }
   Value*& base_ptr = ptr_cache_[non_cst_idx];
   unsigned vector_size = vector_size_;
   Type* ty = ty_;
@@ -212,7 +228,8 @@ Value* shared_tile::get_value(indices_t idx) {
     }
     //    builder_.SetInsertPoint(store);
   }
-  Value* offset = shared_offset(builder_, shapes_, perm_, order_, cst_idx);
+  Value* offset =
+      shared_offset(builder_, shapes_, perm_, order_, cst_idx, swizzle_);
   Value* div = offset;
   if (vector_size_ > 1)
     div = builder_.CreateUDiv(offset, builder_.getInt32(vector_size_));
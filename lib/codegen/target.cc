@@ -28,9 +28,12 @@ Instruction* amd_cl_target::add_barrier(Module* module, IRBuilder<>& builder) {
 }
 
 Value* amd_cl_target::get_global_offset(Module* module, IRBuilder<>& builder,
-                                        unsigned stride, unsigned ax) {
-  Value* group_id = get_block_id(module, builder, ax);
-  Value* result = builder.CreateMul(builder.getInt32(stride), group_id);
+                                        unsigned stride, unsigned ax,
+                                        Type* index_ty) {
+  Value* group_id = builder.CreateZExtOrTrunc(
+      get_block_id(module, builder, ax), index_ty);
+  Value* result =
+      builder.CreateMul(ConstantInt::get(index_ty, stride), group_id);
   return result;
 }
 
@@ -92,9 +95,12 @@ Instruction* nvidia_cu_target::add_memfence(Module* module,
 }
 
 Value* nvidia_cu_target::get_global_offset(Module* module, IRBuilder<>& builder,
-                                           unsigned stride, unsigned ax) {
-  Value* group_id = get_block_id(module, builder, ax);
-  Value* result = builder.CreateMul(builder.getInt32(stride), group_id);
+                                           unsigned stride, unsigned ax,
+                                           Type* index_ty) {
+  Value* group_id = builder.CreateZExtOrTrunc(
+      get_block_id(module, builder, ax), index_ty);
+  Value* result =
+      builder.CreateMul(ConstantInt::get(index_ty, stride), group_id);
   return result;
 }
 
@@ -149,12 +155,10 @@ Instruction* cpu_target::add_memfence(Module* module, IRBuilder<>& builder) {
 
 Value* cpu_target::get_block_id(Module* module, llvm::IRBuilder<>& builder,
                                 unsigned ax) {
-  const Function* fn = builder.GetInsertBlock()->getParent();
+  // the block ids are the last three arguments of the function being built
+  Function* fn = builder.GetInsertBlock()->getParent();
   size_t num_params = fn->getFunctionType()->getNumParams();
-  static std::array<const Argument*, 3> ids = {
-      fn->arg_begin() + num_params - 3, fn->arg_begin() + num_params - 2,
-      fn->arg_begin() + num_params - 1};
-  return (Argument*)ids[ax];
+  return fn->arg_begin() + num_params - 3 + ax;
 }
 
 Value* cpu_target::get_num_blocks(Module* module, IRBuilder<>& builder,
@@ -163,9 +167,12 @@ Value* cpu_target::get_num_blocks(Module* module, IRBuilder<>& builder,
 }
 
 Value* cpu_target::get_global_offset(Module* module, IRBuilder<>& builder,
-                                     unsigned stride, unsigned ax) {
-  Value* result = builder.CreateMul(builder.getInt32(stride),
-                                    get_block_id(module, builder, ax));
+                                     unsigned stride, unsigned ax,
+                                     Type* index_ty) {
+  Value* group_id = builder.CreateZExtOrTrunc(
+      get_block_id(module, builder, ax), index_ty);
+  Value* result =
+      builder.CreateMul(ConstantInt::get(index_ty, stride), group_id);
   return result;
 }
 
@@ -48,9 +48,7 @@ ir::value* coalesce::rematerialize(ir::value* x, ir::builder& builder,
     return x;
   }
   // set insert point
-  auto& inst_list = i->get_parent()->get_inst_list();
-  auto pos = ++std::find(inst_list.begin(), inst_list.end(), i);
-  builder.set_insert_point(pos);
+  builder.set_insert_point_after(i);
   if (dynamic_cast<ir::load_inst*>(x)) {
     ir::value* ret = builder.insert(ir::copy_to_shared_inst::create(x));
     return ret;
@@ -115,11 +113,17 @@ void coalesce::run(ir::module& mod) {
           layout_->get(id)->get_rank())
         extract_ld(i, axes);
     }
-    // update list of values to rematerialize
+    // update list of values to rematerialize; accesses along the leading
+    // axis selected for the layout stay in place
     if (axes.empty())
       continue;
-    for (auto it = ++axes.rbegin(); it != axes.rend(); it++)
-      remat.insert(remat.begin(), it->second.begin(), it->second.end());
+    int leading = axes.rbegin()->first;
+    if (layout_->get(id)->to_scanline() &&
+        axes.count(layout_->get(id)->get_order(0)))
+      leading = layout_->get(id)->get_order(0);
+    for (auto& x : axes)
+      if (x.first != leading)
+        remat.insert(remat.begin(), x.second.begin(), x.second.end());
   }
   // rematerialize values
   for (ir::io_inst* r : remat) {
@@ -129,9 +133,7 @@ void coalesce::run(ir::module& mod) {
     for (ir::value* op : r->ops())
       r->replace_uses_of_with(op, rematerialize(op, mod.get_builder(), seen));
     // copy to shared if load
-    auto& inst_list = r->get_parent()->get_inst_list();
-    auto pos = ++std::find(inst_list.begin(), inst_list.end(), r);
-    builder.set_insert_point(pos);
+    builder.set_insert_point_after(r);
     if (dynamic_cast<ir::load_inst*>(r)) {
       ir::instruction* cts = builder.insert(ir::copy_to_shared_inst::create(r));
       r->replace_all_uses_with(cts);
@@ -49,10 +49,26 @@ void add_copy(ir::instruction* parent, ir::value* x, ir::builder& builder,
     parent->replace_uses_of_with(x, copy);
     return;
   }
-  // phi node
+  // phi node -- incoming values are copied at the end of the block they
+  // come from, so that a value of a loop that also flows into the phi nodes
+  // of the next loop is not copied twice in the loop body
   if (auto* phi = dynamic_cast<ir::phi_node*>(x)) {
-    for (unsigned i = 0; i < phi->get_num_incoming(); ++i)
-      add_copy(phi, phi->get_incoming_value(i), builder, to_shared);
+    for (unsigned n = 0; n < phi->get_num_incoming(); ++n) {
+      ir::value* inc = phi->get_incoming_value(n);
+      if (dynamic_cast<ir::phi_node*>(inc)) {
+        add_copy(phi, inc, builder, to_shared);
+        continue;
+      }
+      if (to_shared && is_shmem_res(inc))
+        continue;
+      builder.set_insert_point(&phi->get_incoming_block(n)->back());
+      ir::value* copy;
+      if (to_shared)
+        copy = builder.create_copy_to_shared(inc);
+      else
+        copy = builder.create_copy_from_shared(inc);
+      phi->set_incoming_value(n, copy);
+    }
     return;
   }
   // already in shared memory
@@ -1,73 +1,209 @@
 #include "tensorscript/codegen/transform/dce.h"
 
+#include <iterator>
+#include <list>
+
 #include "tensorscript/ir/basic_block.h"
+#include "tensorscript/ir/builder.h"
 #include "tensorscript/ir/cfg.h"
 #include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
 #include "tensorscript/ir/module.h"
 
 namespace tensorscript {
 namespace codegen {
 namespace transform {
 
-void dce::run(ir::module& mod) {
-  std::list<ir::instruction*> work_list;
-  std::set<ir::instruction*> marked;
-
-  // initialize work-list
-  for (ir::function* fn : mod.get_function_list()) {
-    std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
-    // iterate through blocks
-    for (ir::basic_block* block : rpo)
-      for (ir::instruction* i : block->get_inst_list()) {
-        switch (i->get_id()) {
-          case ir::INST_RETURN:
-          case ir::INST_UNCOND_BRANCH:
-          case ir::INST_COND_BRANCH:
-          case ir::INST_UNMASKED_STORE:
-          case ir::INST_MASKED_STORE:
-          case ir::INST_ATOMIC_ADD:
-          case ir::INST_ATOMIC_CAS:
-          case ir::INST_ATOMIC_EXCH:
-          case ir::INST_BARRIER: {
-            work_list.push_back(i);
-            marked.insert(i);
-            break;
-          }
-          default:
-            break;
-        }
+// post-dominators of the blocks that reach a return
+void dce::compute_post_dominators(ir::function* fn) {
+  std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
+  // blocks that reach a return
+  std::set<ir::basic_block*> reach_exit;
+  std::list<ir::basic_block*> work_list;
+  for (ir::basic_block* block : rpo)
+    if (block->get_successors().empty()) {
+      reach_exit.insert(block);
+      work_list.push_back(block);
+    }
+  while (!work_list.empty()) {
+    ir::basic_block* current = work_list.front();
+    work_list.pop_front();
+    for (ir::basic_block* pred : current->get_predecessors())
+      if (reach_exit.insert(pred).second)
+        work_list.push_back(pred);
+  }
+  // iterate to a fixed point, starting from every block
+  std::set<ir::basic_block*> all(reach_exit);
+  for (ir::basic_block* block : reach_exit)
+    post_dom_[block] = block->get_successors().empty()
+                           ? std::set<ir::basic_block*>{block}
+                           : all;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = rpo.rbegin(); it != rpo.rend(); ++it) {
+      ir::basic_block* block = *it;
+      if (!reach_exit.count(block) || block->get_successors().empty())
+        continue;
+      std::set<ir::basic_block*> result;
+      bool first = true;
+      for (ir::basic_block* succ : block->get_successors()) {
+        if (!reach_exit.count(succ))
+          continue;
+        const std::set<ir::basic_block*>& other = post_dom_.at(succ);
+        if (first)
+          result = other;
+        else
+          for (auto x = result.begin(); x != result.end();)
+            x = other.count(*x) ? std::next(x) : result.erase(x);
+        first = false;
       }
+      result.insert(block);
+      if (result != post_dom_[block]) {
+        post_dom_[block] = result;
+        changed = true;
+      }
+    }
   }
+  // y is control-dependent on x if it post-dominates a successor of x
+  // without strictly post-dominating x
+  for (ir::basic_block* x : reach_exit) {
+    if (x->get_successors().size() < 2)
+      continue;
+    const std::set<ir::basic_block*>& pdom_x = post_dom_.at(x);
+    for (ir::basic_block* succ : x->get_successors()) {
+      if (!reach_exit.count(succ))
+        continue;
+      for (ir::basic_block* y : post_dom_.at(succ))
+        if (y == x || !pdom_x.count(y))
+          control_deps_[y].insert(x);
+    }
+  }
+}
 
-  // mark -- ignore branches
-  while (!work_list.empty()) {
-    ir::instruction* current = work_list.back();
-    work_list.pop_back();
+// nearest strict post-dominator; nullptr if there is none
+ir::basic_block* dce::get_post_idom(ir::basic_block* block) {
+  auto it = post_dom_.find(block);
+  if (it == post_dom_.end())
+    return nullptr;
+  for (ir::basic_block* x : it->second)
+    if (x != block && post_dom_.at(x).size() + 1 == it->second.size())
+      return x;
+  return nullptr;
+}
+
+void dce::mark(ir::instruction* i) {
+  if (marked_.insert(i).second)
+    work_list_.push_back(i);
+}
+
+void dce::propagate() {
+  while (!work_list_.empty()) {
+    ir::instruction* current = work_list_.back();
+    work_list_.pop_back();
     // mark instruction operands
-    for (ir::value* op : current->ops()) {
-      if (auto* i = dynamic_cast<ir::instruction*>(op)) {
-        if (marked.insert(i).second)
-          work_list.push_back(i);
-      }
-    }
-    // TODO: mark last intstruction of current's reverse-dominance frontier
+    for (ir::value* op : current->ops())
+      if (auto* i = dynamic_cast<ir::instruction*>(op))
+        mark(i);
+    // mark the branches deciding whether current executes
+    auto it = control_deps_.find(current->get_parent());
+    if (it != control_deps_.end())
+      for (ir::basic_block* block : it->second)
+        mark(&block->back());
+    // phi nodes also depend on the edge they are reached through
+    if (auto* phi = dynamic_cast<ir::phi_node*>(current))
+      for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+        mark(&phi->get_incoming_block(n)->back());
   }
+}
 
-  // sweep -- delete non-branch unmarked instructions
-  std::vector<ir::instruction*> to_delete;
-  for (ir::function* fn : mod.get_function_list()) {
-    std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
-    // iterate through blocks
-    for (ir::basic_block* block : rpo)
-      for (ir::instruction* i : block->get_inst_list()) {
-        if (marked.find(i) == marked.end())
-          to_delete.push_back(i);
+// a dead conditional branch jumps to its nearest post-dominator instead;
+// no live phi node there depends on the edge it was reached through
+bool dce::can_bypass(ir::cond_branch_inst* br) {
+  ir::basic_block* target = get_post_idom(br->get_parent());
+  if (!target)
+    return false;
+  for (ir::instruction* i : target->get_inst_list())
+    if (dynamic_cast<ir::phi_node*>(i) && marked_.count(i))
+      return false;
+  return true;
+}
+
+void dce::run(ir::function* fn, ir::builder& builder) {
+  post_dom_.clear();
+  control_deps_.clear();
+  compute_post_dominators(fn);
+  std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
+
+  // side effects are live, and so are the branches of loops that never
+  // return
+  for (ir::basic_block* block : rpo)
+    for (ir::instruction* i : block->get_inst_list()) {
+      switch (i->get_id()) {
+        case ir::INST_RETURN:
+        case ir::INST_UNMASKED_STORE:
+        case ir::INST_MASKED_STORE:
+        case ir::INST_ATOMIC_ADD:
+        case ir::INST_ATOMIC_CAS:
+        case ir::INST_ATOMIC_EXCH:
+        case ir::INST_BARRIER:
+          mark(i);
+          break;
+        case ir::INST_COND_BRANCH:
+          if (!post_dom_.count(block))
+            mark(i);
+          break;
+        default:
+          break;
+      }
+    }
+  propagate();
+  // dead branches that cannot be bypassed are kept
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (ir::basic_block* block : rpo) {
+      auto* br = dynamic_cast<ir::cond_branch_inst*>(&block->back());
+      if (br && !marked_.count(br) && !can_bypass(br)) {
+        mark(br);
+        propagate();
+        changed = true;
       }
+    }
   }
 
-  // delete
+  // sweep -- delete unmarked instructions; unconditional branches stay
+  std::vector<ir::instruction*> to_delete;
+  std::vector<ir::cond_branch_inst*> to_bypass;
+  for (ir::basic_block* block : rpo)
+    for (ir::instruction* i : block->get_inst_list()) {
+      if (marked_.count(i) || i->get_id() == ir::INST_UNCOND_BRANCH)
+        continue;
+      if (auto* br = dynamic_cast<ir::cond_branch_inst*>(i))
+        to_bypass.push_back(br);
+      else
+        to_delete.push_back(i);
+    }
   for (ir::instruction* i : to_delete)
     i->erase_from_parent();
+  for (ir::cond_branch_inst* br : to_bypass) {
+    ir::basic_block* block = br->get_parent();
+    ir::basic_block* target = get_post_idom(block);
+    for (ir::basic_block* succ : {br->get_true_dest(), br->get_false_dest()})
+      succ->remove_predecessor(block);
+    br->erase_from_parent();
+    builder.set_insert_point(block);
+    builder.create_br(target);
+  }
+}
+
+void dce::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  for (ir::function* fn : mod.get_function_list())
+    run(fn, builder);
+  marked_.clear();
+  post_dom_.clear();
+  control_deps_.clear();
 }
 
 }  // namespace transform
@@ -17,20 +17,12 @@ namespace tensorscript {
 namespace codegen {
 namespace transform {
 
-bool membar::intersect(const interval_vec_t& X, interval_t x) {
-  return std::any_of(X.begin(), X.end(), [&](const interval_t& y) {
-    bool left_intersect = y.first <= x.first && x.first < y.second;
-    bool right_intersect = y.first <= x.second && x.second < y.second;
-    return left_intersect || right_intersect;
-  });
+static bool intersect(const std::pair<unsigned, unsigned>& x,
+                      const std::pair<unsigned, unsigned>& y) {
+  return x.first < y.second && y.first < x.second;
 }
 
-bool membar::intersect(const interval_vec_t& X, const interval_vec_t& Y) {
-  return std::any_of(Y.begin(), Y.end(),
-                     [&](const interval_t& y) { return intersect(X, y); });
-}
-
-void membar::add_reference(ir::value* v, interval_vec_t& res) {
+void membar::add_reference(ir::value* v, bool next, access_set_t& res) {
   auto* i = dynamic_cast<ir::instruction*>(v);
   if (!i)
     return;
@@ -39,128 +31,136 @@ void membar::add_reference(ir::value* v, interval_vec_t& res) {
   analysis::shared_layout* layout = layouts_->get(v)->to_shared();
   if (!layout)
     return;
-  if (alloc_->has_offset(layout)) {
-    unsigned offset = alloc_->offset(layout);
-    res.push_back(interval_t(offset, offset + layout->get_size()));
-  }
+  if (!alloc_->has_offset(layout))
+    return;
+  unsigned offset = alloc_->offset(layout);
+  interval_t interval(offset, offset + layout->get_size());
+  res.insert(access_t{interval, layout, next, false});
 }
 
-void membar::get_read_intervals(ir::instruction* i, interval_vec_t& res) {
+void membar::get_accesses(ir::instruction* i, access_set_t& read,
+                          access_set_t& written) {
+  // phi nodes and transpositions only create views of their operands
+  if (dynamic_cast<ir::phi_node*>(i) || dynamic_cast<ir::trans_inst*>(i))
+    return;
+  auto is_next = [&](ir::value* v) {
+    auto* layout = layouts_->get(v)->to_shared();
+    auto* info = layout ? layout->get_double_buffer() : nullptr;
+    return info && (v == info->first || v == info->latch);
+  };
   for (ir::value* op : i->ops())
-    add_reference(op, res);
+    if (op->get_type()->is_tile_ty())
+      add_reference(op, is_next(op), read);
+  if (i->get_type()->is_tile_ty())
+    add_reference(i, is_next(i), written);
 }
 
-void membar::get_written_intervals(ir::instruction* i, interval_vec_t& res) {
-  if (!dynamic_cast<ir::phi_node*>(i) && !dynamic_cast<ir::trans_inst*>(i))
-    add_reference(i, res);
+bool membar::read_after_write(const access_set_t& written,
+                              const access_set_t& read) {
+  for (const access_t& w : written)
+    for (const access_t& r : read)
+      if (intersect(w.interval, r.interval))
+        return true;
+  return false;
 }
 
-void membar::insert_barrier(ir::instruction* instr, ir::builder& builder) {
-  if (auto* phi = dynamic_cast<ir::phi_node*>(instr)) {
-    std::set<ir::value*> incoming;
-    for (unsigned n = 0; n < phi->get_num_incoming(); n++) {
-      ir::instruction* inc_val =
-          dynamic_cast<ir::instruction*>(phi->get_incoming_value(n));
-      assert(inc_val);
-      if (incoming.insert(inc_val).second) {
-        ir::basic_block* block = inc_val->get_parent();
-        builder.set_insert_point(block->get_inst_list().back());
-        builder.create_barrier();
-      }
+bool membar::write_after_read(const access_set_t& read,
+                              const access_set_t& written) {
+  for (const access_t& r : read)
+    for (const access_t& w : written) {
+      // the next half of a double buffer is not read in this iteration
+      if (r.layout == w.layout && w.next && !r.next && !r.carried)
+        continue;
+      if (intersect(w.interval, r.interval))
+        return true;
     }
-  } else {
-    builder.set_insert_point(instr);
-    builder.create_barrier();
-  }
-}
-
-membar::interval_vec_t membar::join(
-    const std::vector<interval_vec_t>& intervals) {
-  membar::interval_vec_t result;
-  for (auto x : intervals)
-    for (interval_t i : x)
-      result.push_back(i);
-  return result;
+  return false;
 }
 
-std::pair<membar::interval_vec_t, membar::interval_vec_t> membar::transfer(
-    ir::basic_block* block, const interval_vec_t& written_to,
-    const interval_vec_t& read_from, std::set<ir::instruction*>& insert_loc,
-    std::set<ir::value*>& safe_war) {
-  ir::basic_block::inst_list_t instructions = block->get_inst_list();
-  interval_vec_t new_written_to = written_to;
-  interval_vec_t new_read_from = read_from;
-
-  for (ir::instruction* i : instructions) {
-    interval_vec_t read, written;
-    get_read_intervals(i, read);
-    get_written_intervals(i, written);
-    bool read_after_write = intersect(new_written_to, read);
-    bool write_after_read = intersect(new_read_from, written);
-    // double buffering
-    if (safe_war.find(i) != safe_war.end()) {
-      write_after_read = false;
-      read_after_write = false;
+membar::state_t membar::transfer(ir::basic_block* block, state_t state,
+                                 std::set<ir::instruction*>& insert_loc) {
+  for (ir::instruction* i : block->get_inst_list()) {
+    // existing barriers
+    if (dynamic_cast<ir::barrier_inst*>(i)) {
+      state = state_t();
+      continue;
     }
-    // record hazards
-    if (read_after_write || write_after_read) {
+    access_set_t read, written;
+    get_accesses(i, read, written);
+    if (insert_loc.count(i) || read_after_write(state.written, read) ||
+        write_after_read(state.read, written)) {
       insert_loc.insert(i);
-      new_written_to.clear();
-      new_read_from.clear();
+      state = state_t();
     }
-    std::copy(written.begin(), written.end(),
-              std::back_inserter(new_written_to));
-    std::copy(read.begin(), read.end(), std::back_inserter(new_read_from));
+    state.written.insert(written.begin(), written.end());
+    state.read.insert(read.begin(), read.end());
   }
-  return std::make_pair(new_written_to, new_read_from);
+  return state;
 }
 
-void membar::run(ir::module& mod) {
-  ir::builder& builder = mod.get_builder();
-  // extract phi-node associates with double-buffered
-  // shared-memory copies. These can be read from and written to
-  // without needing synchronization
-  std::set<ir::value*> safe_war;
-  for (const auto& x : layouts_->get_all()) {
-    analysis::shared_layout* layout = x.second->to_shared();
-    if (!layout || !layout->get_double_buffer())
-      continue;
-    for (ir::value* v : layout->get_values())
-      if (v != layout->get_double_buffer()->phi)
-        safe_war.insert(v);
+void membar::run(ir::function* fn, ir::builder& builder) {
+  std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
+  std::map<ir::basic_block*, size_t> rpo_index;
+  for (size_t n = 0; n < rpo.size(); n++)
+    rpo_index[rpo[n]] = n;
+  std::set<ir::instruction*> insert_locs;
+  std::map<ir::basic_block*, state_t> out;
+  // barrier locations only grow; whenever one is added the states are
+  // recomputed from scratch so that they converge to the least fixed point
+  bool changed = true;
+  size_t num_locs = 0;
+  while (changed) {
+    changed = false;
+    for (ir::basic_block* block : rpo) {
+      state_t state;
+      for (ir::basic_block* pred : block->get_predecessors()) {
+        // unreachable predecessors carry nothing
+        if (!rpo_index.count(pred))
+          continue;
+        const state_t& pred_state = out[pred];
+        state.written.insert(pred_state.written.begin(),
+                             pred_state.written.end());
+        if (rpo_index.at(pred) < rpo_index.at(block)) {
+          state.read.insert(pred_state.read.begin(), pred_state.read.end());
+          continue;
+        }
+        // back-edge: the reads belong to the previous iteration
+        for (access_t r : pred_state.read) {
+          r.carried = true;
+          state.read.insert(r);
+        }
+      }
+      state_t result = transfer(block, state, insert_locs);
+      if (result != out[block]) {
+        out[block] = std::move(result);
+        changed = true;
+      }
+    }
+    if (insert_locs.size() != num_locs) {
+      num_locs = insert_locs.size();
+      out.clear();
+      changed = true;
+    }
   }
 
-  for (ir::function* fn : mod.get_function_list()) {
-    std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
-    std::map<ir::basic_block*, interval_vec_t> written_to;
-    std::map<ir::basic_block*, interval_vec_t> read_from;
-    std::set<ir::instruction*> insert_locs;
-    size_t n_inserted_im1 = 0;
-    bool done = false;
-    do {
-      // find barrier location
-      for (ir::basic_block* block : rpo) {
-        // written to
-        std::vector<interval_vec_t> pred_written_to;
-        for (ir::basic_block* pred : block->get_predecessors())
-          pred_written_to.push_back(written_to[pred]);
-        // read from
-        std::vector<interval_vec_t> pred_read_from;
-        for (ir::basic_block* pred : block->get_predecessors())
-          pred_read_from.push_back(read_from[pred]);
-        // apply transfer function
-        auto result = transfer(block, join(pred_written_to),
-                               join(pred_read_from), insert_locs, safe_war);
-        written_to[block] = result.first;
-        read_from[block] = result.second;
-      }
-      size_t n_inserted_i = insert_locs.size();
-      done = (n_inserted_im1 == n_inserted_i);
-      n_inserted_im1 = n_inserted_i;
-    } while (!done);
-    for (ir::instruction* i : insert_locs)
-      insert_barrier(i, builder);
+  // insert barriers
+  for (ir::instruction* i : insert_locs) {
+    builder.set_insert_point(i);
+    builder.create_barrier();
   }
+
+  unsigned num_barriers = 0;
+  for (ir::basic_block* block : fn->blocks())
+    for (ir::instruction* i : block->get_inst_list())
+      num_barriers += dynamic_cast<ir::barrier_inst*>(i) != nullptr;
+  num_barriers_[fn] = num_barriers;
+}
+
+void membar::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  num_barriers_.clear();
+  for (ir::function* fn : mod.get_function_list())
+    run(fn, builder);
 }
 
 }  // namespace transform
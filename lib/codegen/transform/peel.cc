@@ -0,0 +1,397 @@
+#include "tensorscript/codegen/transform/peel.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
+#include "tensorscript/codegen/analysis/range.h"
+#include "tensorscript/ir/basic_block.h"
+#include "tensorscript/ir/builder.h"
+#include "tensorscript/ir/constant.h"
+#include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
+#include "tensorscript/ir/module.h"
+
+namespace tensorscript {
+namespace codegen {
+namespace transform {
+
+// scalar broadcast to every element of v, if any
+static ir::value* get_uniform_scalar(ir::value* v) {
+  while (v->get_type()->is_tile_ty()) {
+    auto* i = dynamic_cast<ir::instruction*>(v);
+    if (!i)
+      return nullptr;
+    ir::value_id_t id = i->get_id();
+    if (id != ir::INST_SPLAT && id != ir::INST_BROADCAST &&
+        id != ir::INST_RESHAPE)
+      return nullptr;
+    v = i->get_operand(0);
+  }
+  return v;
+}
+
+static ir::cmp_pred_t swap_operands(ir::cmp_pred_t pred) {
+  switch (pred) {
+    case ir::ICMP_SLT:
+      return ir::ICMP_SGT;
+    case ir::ICMP_SLE:
+      return ir::ICMP_SGE;
+    case ir::ICMP_SGT:
+      return ir::ICMP_SLT;
+    case ir::ICMP_SGE:
+      return ir::ICMP_SLE;
+    default:
+      return pred;
+  }
+}
+
+static ir::value* map_value(ir::value* v,
+                            const std::map<ir::value*, ir::value*>& vmap) {
+  auto it = vmap.find(v);
+  return it == vmap.end() ? v : it->second;
+}
+
+// whether v can be recomputed from the phi nodes of the loop. only scalar
+// operations that cannot trap are recomputed, since the guard of the next
+// iteration is evaluated before the loop condition is known to hold
+bool peel::is_rematerializable(ir::value* v, ir::basic_block* loop) {
+  auto* i = dynamic_cast<ir::instruction*>(v);
+  if (!i || i->get_parent() != loop || dynamic_cast<ir::phi_node*>(i))
+    return true;
+  if (i->get_type()->is_tile_ty())
+    return false;
+  switch (i->get_id()) {
+    case ir::INST_BINOP: {
+      ir::binary_op_t op = static_cast<ir::binary_operator*>(i)->get_op();
+      if (op == ir::UDiv || op == ir::SDiv || op == ir::URem ||
+          op == ir::SRem)
+        return false;
+      break;
+    }
+    case ir::INST_ICMP:
+    case ir::INST_SELECT:
+    case ir::INST_CAST_TRUNC:
+    case ir::INST_CAST_ZEXT:
+    case ir::INST_CAST_SEXT:
+      break;
+    default:
+      return false;
+  }
+  for (ir::value* op : i->ops())
+    if (!is_rematerializable(op, loop))
+      return false;
+  return true;
+}
+
+// recomputes v at the insertion point of the builder. vmap holds the
+// values that the phi nodes of the loop take there
+ir::value* peel::rematerialize(ir::value* v, ir::basic_block* loop,
+                               value_map_t& vmap, ir::builder& builder) {
+  auto it = vmap.find(v);
+  if (it != vmap.end())
+    return it->second;
+  auto* i = dynamic_cast<ir::instruction*>(v);
+  if (!i || i->get_parent() != loop)
+    return v;
+  ir::instruction* clone = i->clone();
+  for (unsigned k = 0; k < clone->get_num_operands(); k++)
+    clone->set_operand(
+        k, rematerialize(i->get_operand(k), loop, vmap, builder));
+  builder.insert(clone, i->get_name());
+  vmap[v] = clone;
+  return clone;
+}
+
+// appends to guards the conditions under which mask is all-true. returns
+// false if no such scalar conditions were found
+bool peel::collect_guards(ir::value* mask, ir::basic_block* loop,
+                          std::vector<guard_t>& guards) {
+  if (auto* x = dynamic_cast<ir::binary_operator*>(mask))
+    if (x->get_op() == ir::And)
+      return collect_guards(x->get_operand(0), loop, guards) &&
+             collect_guards(x->get_operand(1), loop, guards);
+  if (auto* x = dynamic_cast<ir::instruction*>(mask)) {
+    ir::value_id_t id = x->get_id();
+    if (id == ir::INST_SPLAT || id == ir::INST_BROADCAST ||
+        id == ir::INST_RESHAPE)
+      return collect_guards(x->get_operand(0), loop, guards);
+  }
+  if (!mask->get_type()->is_tile_ty()) {
+    if (!is_rematerializable(mask, loop))
+      return false;
+    guards.push_back({mask, ir::ICMP_NE, 0});
+    return true;
+  }
+  // element < splat(scalar) and alike hold for every element if they hold
+  // for the bound of the range of the elements
+  auto* cmp = dynamic_cast<ir::icmp_inst*>(mask);
+  if (!cmp)
+    return false;
+  ir::cmp_pred_t pred = cmp->get_pred();
+  ir::value* elements = cmp->get_operand(0);
+  ir::value* scalar = get_uniform_scalar(cmp->get_operand(1));
+  if (!scalar) {
+    elements = cmp->get_operand(1);
+    scalar = get_uniform_scalar(cmp->get_operand(0));
+    pred = swap_operands(pred);
+  }
+  if (!scalar || !scalar->get_type()->is_integer_ty() ||
+      !is_rematerializable(scalar, loop))
+    return false;
+  unsigned bits = scalar->get_type()->get_integer_bitwidth();
+  int64_t max = bits >= 64 ? std::numeric_limits<int64_t>::max()
+                           : (int64_t(1) << (bits - 1)) - 1;
+  int64_t min = -max - 1;
+  analysis::range::interval_t r = range_->get(elements);
+  if (r.empty() || (r.lo <= min && r.hi >= max))
+    return false;
+  switch (pred) {
+    case ir::ICMP_SLT:
+      if (r.hi == max)
+        return false;
+      guards.push_back({scalar, ir::ICMP_SGT, r.hi});
+      return true;
+    case ir::ICMP_SLE:
+      guards.push_back({scalar, ir::ICMP_SGE, r.hi});
+      return true;
+    case ir::ICMP_SGT:
+      if (r.lo == min)
+        return false;
+      guards.push_back({scalar, ir::ICMP_SLT, r.lo});
+      return true;
+    case ir::ICMP_SGE:
+      guards.push_back({scalar, ir::ICMP_SLE, r.lo});
+      return true;
+    default:
+      return false;
+  }
+}
+
+ir::value* peel::create_guard(const std::vector<guard_t>& guards,
+                              ir::basic_block* loop, value_map_t& vmap,
+                              ir::builder& builder) {
+  ir::value* result = nullptr;
+  for (const guard_t& guard : guards) {
+    ir::value* scalar = rematerialize(guard.scalar, loop, vmap, builder);
+    ir::type* ty = scalar->get_type();
+    unsigned bits = ty->get_integer_bitwidth();
+    uint64_t bound = guard.bound;
+    if (bits < 64)
+      bound &= (uint64_t(1) << bits) - 1;
+    ir::value* cond = builder.create_icmp(
+        guard.pred, scalar, ir::constant_int::get(ty, bound));
+    result = result ? builder.create_and(result, cond) : cond;
+  }
+  return result;
+}
+
+// copies the body of loop into block, where the phi nodes take the values
+// init from pred. masked I/O in unmasked becomes unmasked
+void peel::clone_body(ir::basic_block* loop, ir::basic_block* block,
+                      ir::basic_block* pred, const value_map_t& init,
+                      const std::set<ir::instruction*>& unmasked,
+                      value_map_t& vmap, ir::builder& builder) {
+  builder.set_insert_point(block);
+  std::vector<ir::phi_node*> phis;
+  for (ir::instruction* i : loop->get_inst_list())
+    if (auto* phi = dynamic_cast<ir::phi_node*>(i)) {
+      phis.push_back(phi);
+      vmap[phi] = builder.create_phi(phi->get_type(), 2, phi->get_name());
+    }
+  for (ir::instruction* i : loop->get_inst_list()) {
+    if (dynamic_cast<ir::phi_node*>(i) || i == &loop->back())
+      continue;
+    ir::instruction* clone;
+    if (unmasked.find(i) == unmasked.end()) {
+      clone = i->clone();
+      for (unsigned k = 0; k < clone->get_num_operands(); k++)
+        clone->set_operand(k, map_value(i->get_operand(k), vmap));
+    } else if (auto* x = dynamic_cast<ir::masked_load_inst*>(i)) {
+      clone = ir::unmasked_load_inst::create(
+          map_value(x->get_pointer_operand(), vmap));
+    } else {
+      auto* y = static_cast<ir::masked_store_inst*>(i);
+      clone = ir::unmasked_store_inst::create(
+          map_value(y->get_pointer_operand(), vmap),
+          map_value(y->get_value_operand(), vmap));
+    }
+    for (const auto& md : i->get_metadatas())
+      clone->set_metadata(md.first, md.second);
+    builder.insert(clone, i->get_name());
+    vmap[i] = clone;
+  }
+  for (ir::phi_node* phi : phis) {
+    auto* clone = static_cast<ir::phi_node*>(vmap.at(phi));
+    clone->add_incoming(init.at(phi), pred);
+    for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+      if (phi->get_incoming_block(n) == loop)
+        clone->add_incoming(map_value(phi->get_incoming_value(n), vmap),
+                            block);
+  }
+}
+
+bool peel::run(ir::basic_block* loop, ir::builder& builder) {
+  // single-block loop with a single preheader
+  auto* br = dynamic_cast<ir::cond_branch_inst*>(&loop->back());
+  if (!br)
+    return false;
+  bool latch_true = br->get_true_dest() == loop;
+  bool latch_false = br->get_false_dest() == loop;
+  if (latch_true == latch_false)
+    return false;
+  ir::basic_block* exit = latch_true ? br->get_false_dest()
+                                     : br->get_true_dest();
+  const std::vector<ir::basic_block*>& preds = loop->get_predecessors();
+  if (preds.size() != 2 || std::count(preds.begin(), preds.end(), loop) != 1)
+    return false;
+  ir::basic_block* preheader = preds[0] == loop ? preds[1] : preds[0];
+  std::vector<ir::phi_node*> phis;
+  for (ir::instruction* i : loop->get_inst_list())
+    if (auto* phi = dynamic_cast<ir::phi_node*>(i))
+      phis.push_back(phi);
+  // the copies made by cts would be shared by the phi nodes of several
+  // loops, which cannot be double-buffered
+  for (ir::phi_node* phi : phis)
+    for (ir::value* op : phi->ops())
+      if (dynamic_cast<ir::copy_to_shared_inst*>(op))
+        return false;
+
+  // masked I/O that the guards make unconditional
+  std::vector<guard_t> guards;
+  std::set<ir::instruction*> unmasked;
+  for (ir::instruction* i : loop->get_inst_list()) {
+    ir::value* mask = nullptr;
+    if (auto* x = dynamic_cast<ir::masked_load_inst*>(i))
+      mask = x->get_mask_operand();
+    if (auto* x = dynamic_cast<ir::masked_store_inst*>(i))
+      mask = x->get_mask_operand();
+    std::vector<guard_t> current;
+    if (!mask || !collect_guards(mask, loop, current))
+      continue;
+    unmasked.insert(i);
+    for (const guard_t& guard : current)
+      if (std::find(guards.begin(), guards.end(), guard) == guards.end())
+        guards.push_back(guard);
+  }
+  if (unmasked.empty())
+    return false;
+
+  // values of the loop used after it other than through the phi nodes of
+  // the exit. they are merged by new phi nodes, which needs the loop to be
+  // the only predecessor of the exit
+  std::vector<std::pair<ir::instruction*, std::set<ir::user*>>> escaping;
+  for (ir::instruction* i : loop->get_inst_list()) {
+    std::set<ir::user*> users;
+    for (ir::user* u : i->get_users()) {
+      auto* x = static_cast<ir::instruction*>(u);
+      if (x->get_parent() == loop)
+        continue;
+      if (x->get_parent() == exit && dynamic_cast<ir::phi_node*>(x))
+        continue;
+      users.insert(u);
+    }
+    if (!users.empty())
+      escaping.push_back({i, users});
+  }
+  if (!escaping.empty() && exit->get_predecessors().size() != 1)
+    return false;
+
+  ir::context& ctx = loop->get_context();
+  ir::function* fn = loop->get_parent();
+  std::string name = loop->get_name();
+  auto* entry = ir::basic_block::create(ctx, name + ".peel", nullptr);
+  auto* main = ir::basic_block::create(ctx, name + ".main", nullptr);
+  auto* remainder = ir::basic_block::create(ctx, name + ".rem", nullptr);
+  auto* tail = ir::basic_block::create(ctx, name + ".tail", nullptr);
+  fn->insert_block(entry, loop);
+  fn->insert_block(main, loop);
+  fn->insert_block(remainder, loop);
+  fn->insert_block(tail, loop);
+
+  // the preheader enters the unmasked loop if the first iteration is in
+  // bounds, and the masked loop otherwise
+  ir::instruction* pre_term = &preheader->back();
+  for (unsigned k = 0; k < pre_term->get_num_operands(); k++)
+    if (pre_term->get_operand(k) == loop) {
+      pre_term->set_operand(k, entry);
+      loop->remove_predecessor(preheader);
+      entry->add_predecessor(preheader);
+    }
+  value_map_t first;
+  for (ir::phi_node* phi : phis)
+    for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+      if (phi->get_incoming_block(n) == preheader) {
+        phi->set_incoming_block(n, entry);
+        first[phi] = phi->get_incoming_value(n);
+      }
+  builder.set_insert_point(entry);
+  builder.create_cond_br(create_guard(guards, loop, first, builder), main,
+                         loop);
+
+  // unmasked copy of the loop
+  value_map_t vmap;
+  clone_body(loop, main, entry, first, unmasked, vmap, builder);
+  value_map_t next;
+  for (ir::phi_node* phi : phis)
+    for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+      if (phi->get_incoming_block(n) == loop)
+        next[phi] = map_value(phi->get_incoming_value(n), vmap);
+  // stay in the unmasked loop while the next iteration is in bounds too
+  ir::value* cond = map_value(br->get_cond(), vmap);
+  ir::value* cont = cond;
+  if (!latch_true)
+    cont = builder.create_xor(cond, ir::constant_int::get(cond->get_type(), 1));
+  ir::value* guard = create_guard(guards, loop, next, builder);
+  builder.create_cond_br(builder.create_and(cont, guard), main, remainder);
+
+  // the remaining iterations run in a masked copy of the loop, so that the
+  // phi nodes of every loop keep one incoming value from outside and one
+  // from the latch
+  value_map_t tail_map;
+  clone_body(loop, tail, remainder, next, {}, tail_map, builder);
+  ir::value* tail_cond = map_value(br->get_cond(), tail_map);
+  builder.create_cond_br(tail_cond, latch_true ? tail : exit,
+                         latch_true ? exit : tail);
+  builder.set_insert_point(remainder);
+  builder.create_cond_br(cond, latch_true ? tail : exit,
+                         latch_true ? exit : tail);
+  for (ir::instruction* i : exit->get_inst_list()) {
+    auto* phi = dynamic_cast<ir::phi_node*>(i);
+    if (!phi)
+      break;
+    for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+      if (phi->get_incoming_block(n) == loop) {
+        ir::value* v = phi->get_incoming_value(n);
+        phi->add_incoming(map_value(v, vmap), remainder);
+        phi->add_incoming(map_value(v, tail_map), tail);
+        break;
+      }
+  }
+  if (!escaping.empty())
+    builder.set_insert_point(exit->get_first_non_phi());
+  for (auto& x : escaping) {
+    ir::phi_node* phi =
+        builder.create_phi(x.first->get_type(), 3, x.first->get_name());
+    phi->add_incoming(x.first, loop);
+    phi->add_incoming(map_value(x.first, vmap), remainder);
+    phi->add_incoming(map_value(x.first, tail_map), tail);
+    for (ir::user* u : x.second)
+      u->replace_uses_of_with(x.first, phi);
+  }
+  return true;
+}
+
+void peel::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  for (ir::function* fn : mod.get_function_list()) {
+    // the blocks created for a loop are not peeled again
+    std::vector<ir::basic_block*> blocks = fn->blocks();
+    for (ir::basic_block* block : blocks)
+      run(block, builder);
+  }
+}
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
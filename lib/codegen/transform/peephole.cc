@@ -24,10 +24,7 @@ ir::value* rewrite_trans_phi_impl(ir::value* value, ir::builder& builder,
       result->add_incoming(incs[n], phi->get_incoming_block(n));
     return result;
   } else if (auto i = dynamic_cast<ir::instruction*>(value)) {
-    ir::basic_block* block = i->get_parent();
-    auto it = std::find(block->begin(), block->end(), i);
-    it++;
-    builder.set_insert_point(it);
+    builder.set_insert_point_after(i);
     ir::instruction* trans = (ir::instruction*)builder.create_trans(i, perm);
     trans->set_operand(0, i);
     return trans;
@@ -39,9 +36,8 @@ bool peephole::rewrite_trans_phi(ir::instruction* value, ir::builder& builder) {
   auto trans = dynamic_cast<ir::trans_inst*>(value);
   if (!trans)
     return false;
-  auto users = trans->get_users();
   auto ops = trans->ops();
-  if (users.size() > 1 || ops.size() > 1)
+  if (trans->get_num_uses() > 1 || ops.size() > 1)
     return false;
   ir::value* op = *ops.begin();
   // trans(phi) -> phi(trans(), trans()...)
@@ -218,7 +218,7 @@ void reassociate::run(ir::module& mod) {
             // reassociate phi-node pointer
             if (ir::phi_node* phi = dynamic_cast<ir::phi_node*>(py)) {
               // only optimize the case where py = phi pa, pz for now
-              std::vector<ir::value*> ops = phi->ops();
+              std::vector<ir::value*> ops(phi->op_begin(), phi->op_end());
               if (ops.size() != 2)
                 continue;
               if (ops[0] != pz && ops[1] != pz)
@@ -246,12 +246,8 @@ void reassociate::run(ir::module& mod) {
                   builder.create_gep(phi_dyn, {off}, phi->get_name() + "_sta");
               phi->replace_all_uses_with(phi_sta);
               // remove offset from pz
-              if (auto* x = dynamic_cast<ir::instruction*>(pz)) {
-                auto insts = x->get_parent()->get_inst_list();
-                auto it = std::find(insts.begin(), insts.end(), x);
-                it++;
-                builder.set_insert_point(*it);
-              }
+              if (auto* x = dynamic_cast<ir::instruction*>(pz))
+                builder.set_insert_point_after(x);
               ir::value* _0 = builder.get_int32(0);
               if (off->get_type()->is_tile_ty())
                 _0 = builder.create_splat(_0,
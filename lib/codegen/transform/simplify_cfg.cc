@@ -0,0 +1,202 @@
+#include "tensorscript/codegen/transform/simplify_cfg.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "tensorscript/ir/basic_block.h"
+#include "tensorscript/ir/constant.h"
+#include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
+#include "tensorscript/ir/module.h"
+
+namespace tensorscript {
+namespace codegen {
+namespace transform {
+
+static std::vector<ir::phi_node*> get_phis(ir::basic_block* block) {
+  std::vector<ir::phi_node*> result;
+  for (ir::instruction* i : block->get_inst_list()) {
+    auto* phi = dynamic_cast<ir::phi_node*>(i);
+    if (!phi)
+      break;
+    result.push_back(phi);
+  }
+  return result;
+}
+
+// drops one edge from pred to block
+void simplify_cfg::remove_incoming(ir::basic_block* block,
+                                   ir::basic_block* pred) {
+  for (ir::phi_node* phi : get_phis(block))
+    for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+      if (phi->get_incoming_block(n) == pred) {
+        phi->remove_incoming(n);
+        break;
+      }
+  block->remove_predecessor(pred);
+}
+
+// conditional branches on constants, or to the same block twice
+bool simplify_cfg::fold_branches(ir::function* fn) {
+  bool changed = false;
+  for (ir::basic_block* block : fn->blocks()) {
+    auto* br = dynamic_cast<ir::cond_branch_inst*>(&block->back());
+    if (!br)
+      continue;
+    ir::basic_block* taken = br->get_true_dest();
+    ir::basic_block* not_taken = br->get_false_dest();
+    auto* cond = dynamic_cast<ir::constant_int*>(br->get_cond());
+    if (cond && !(cond->get_value() & 1))
+      std::swap(taken, not_taken);
+    if (!cond && taken != not_taken)
+      continue;
+    remove_incoming(not_taken, block);
+    br->erase_from_parent();
+    // the edge to the taken block already exists
+    block->get_inst_list().push_back(ir::branch_inst::create(taken));
+    changed = true;
+  }
+  return changed;
+}
+
+bool simplify_cfg::remove_unreachable(ir::function* fn) {
+  ir::basic_block* entry = fn->blocks().front();
+  std::set<ir::basic_block*> reachable = {entry};
+  std::vector<ir::basic_block*> stack = {entry};
+  while (!stack.empty()) {
+    ir::basic_block* current = stack.back();
+    stack.pop_back();
+    for (ir::basic_block* succ : current->get_successors())
+      if (reachable.insert(succ).second)
+        stack.push_back(succ);
+  }
+  std::vector<ir::basic_block*> dead;
+  for (ir::basic_block* block : fn->blocks())
+    if (!reachable.count(block))
+      dead.push_back(block);
+  // the instructions of unreachable blocks are only used in unreachable
+  // blocks, or by phi nodes through the edges removed here
+  for (ir::basic_block* block : dead) {
+    std::vector<ir::basic_block*> succs = block->get_successors();
+    for (ir::basic_block* succ : succs)
+      remove_incoming(succ, block);
+  }
+  for (ir::basic_block* block : dead)
+    for (ir::instruction* i : block->get_inst_list())
+      i->drop_all_references();
+  for (ir::basic_block* block : dead)
+    fn->erase_block(block);
+  return !dead.empty();
+}
+
+// blocks that only jump to another block are bypassed, unless a
+// predecessor also jumps to that block and it has phi nodes
+bool simplify_cfg::bypass_empty(ir::function* fn) {
+  bool changed = false;
+  std::vector<ir::basic_block*> blocks = fn->blocks();
+  for (ir::basic_block* block : blocks) {
+    if (block == fn->blocks().front() || block->size() != 1)
+      continue;
+    auto* br = dynamic_cast<ir::uncond_branch_inst*>(&block->back());
+    if (!br || br->get_dest() == block)
+      continue;
+    ir::basic_block* dest = br->get_dest();
+    std::vector<ir::phi_node*> phis = get_phis(dest);
+    std::vector<ir::basic_block*> preds = block->get_predecessors();
+    const std::vector<ir::basic_block*>& dest_preds = dest->get_predecessors();
+    bool conflict = false;
+    for (ir::basic_block* pred : preds)
+      conflict |= std::find(dest_preds.begin(), dest_preds.end(), pred) !=
+                  dest_preds.end();
+    if (preds.empty() || (conflict && !phis.empty()))
+      continue;
+    // retarget the predecessors
+    for (ir::basic_block* pred : preds) {
+      ir::instruction* term = &pred->back();
+      for (unsigned k = 0; k < term->get_num_operands(); k++)
+        if (term->get_operand(k) == block) {
+          term->set_operand(k, dest);
+          block->remove_predecessor(pred);
+          dest->add_predecessor(pred);
+        }
+    }
+    for (ir::phi_node* phi : phis)
+      for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+        if (phi->get_incoming_block(n) == block) {
+          ir::value* v = phi->get_incoming_value(n);
+          phi->remove_incoming(n);
+          for (ir::basic_block* pred : preds)
+            phi->add_incoming(v, pred);
+          break;
+        }
+    dest->remove_predecessor(block);
+    br->erase_from_parent();
+    fn->erase_block(block);
+    changed = true;
+  }
+  return changed;
+}
+
+// a block is merged into its single predecessor if the latter only jumps
+// to it
+bool simplify_cfg::merge_blocks(ir::function* fn) {
+  bool changed = false;
+  std::vector<ir::basic_block*> blocks = fn->blocks();
+  std::set<ir::basic_block*> merged;
+  for (ir::basic_block* block : blocks) {
+    if (merged.count(block))
+      continue;
+    auto* br = dynamic_cast<ir::uncond_branch_inst*>(&block->back());
+    if (!br)
+      continue;
+    ir::basic_block* succ = br->get_dest();
+    if (succ == block || succ == fn->blocks().front() ||
+        succ->get_predecessors().size() != 1)
+      continue;
+    // phi nodes of succ have a single incoming value
+    for (ir::phi_node* phi : get_phis(succ)) {
+      phi->replace_all_uses_with(phi->get_incoming_value(0));
+      phi->erase_from_parent();
+    }
+    br->erase_from_parent();
+    succ->remove_predecessor(block);
+    std::vector<ir::instruction*> insts(succ->begin(), succ->end());
+    for (ir::instruction* i : insts) {
+      succ->erase(i);
+      block->get_inst_list().push_back(i);
+    }
+    // the successors of succ are now reached from block
+    std::vector<ir::basic_block*> succs = succ->get_successors();
+    for (ir::basic_block* next : succs) {
+      next->remove_predecessor(succ);
+      next->add_predecessor(block);
+      for (ir::phi_node* phi : get_phis(next))
+        for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+          if (phi->get_incoming_block(n) == succ)
+            phi->set_incoming_block(n, block);
+    }
+    fn->erase_block(succ);
+    merged.insert(succ);
+    changed = true;
+  }
+  return changed;
+}
+
+void simplify_cfg::run(ir::module& mod) {
+  for (ir::function* fn : mod.get_function_list()) {
+    if (fn->blocks().empty())
+      continue;
+    bool changed = true;
+    while (changed) {
+      changed = fold_branches(fn);
+      changed |= remove_unreachable(fn);
+      changed |= bypass_empty(fn);
+      changed |= merge_blocks(fn);
+    }
+  }
+}
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
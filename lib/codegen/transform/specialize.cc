@@ -0,0 +1,38 @@
+#include "tensorscript/codegen/transform/specialize.h"
+
+#include "tensorscript/ir/constant.h"
+#include "tensorscript/ir/function.h"
+#include "tensorscript/ir/module.h"
+#include "tensorscript/ir/type.h"
+
+namespace tensorscript {
+namespace codegen {
+namespace transform {
+
+void specialize::run(ir::module& mod) {
+  for (ir::function* fn : mod.get_function_list()) {
+    const auto& args = fn->args();
+    for (size_t i = 0; i < args.size() && i < key_.size(); i++) {
+      ir::argument* arg = args[i];
+      ir::type* ty = arg->get_type();
+      switch (key_[i]) {
+        case arg_equal_to_1:
+          if (ty->is_integer_ty())
+            arg->replace_all_uses_with(ir::constant_int::get(ty, 1));
+          break;
+        case arg_divisible_by_16:
+          if (ty->is_integer_ty())
+            fn->add_attr(i + 1, ir::attribute(ir::multiple_of, 16));
+          else if (ty->is_pointer_ty())
+            fn->add_attr(i + 1, ir::attribute(ir::aligned, 16));
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
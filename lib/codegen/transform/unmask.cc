@@ -0,0 +1,85 @@
+#include "tensorscript/codegen/transform/unmask.h"
+
+#include <set>
+#include <vector>
+
+#include "tensorscript/codegen/analysis/range.h"
+#include "tensorscript/ir/basic_block.h"
+#include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
+#include "tensorscript/ir/module.h"
+
+namespace tensorscript {
+namespace codegen {
+namespace transform {
+
+// instructions without side effects that only feed masks
+static bool is_mask_computation(ir::instruction* i) {
+  return dynamic_cast<ir::cmp_inst*>(i) ||
+         dynamic_cast<ir::binary_operator*>(i) ||
+         dynamic_cast<ir::splat_inst*>(i) ||
+         dynamic_cast<ir::broadcast_inst*>(i) ||
+         dynamic_cast<ir::reshape_inst*>(i);
+}
+
+void unmask::erase_dead(ir::instruction* i) {
+  std::vector<ir::instruction*> worklist = {i};
+  // an instruction may appear several times in an operand list
+  std::set<ir::instruction*> erased;
+  while (!worklist.empty()) {
+    ir::instruction* current = worklist.back();
+    worklist.pop_back();
+    if (erased.count(current) || current->has_uses() ||
+        !is_mask_computation(current))
+      continue;
+    std::vector<ir::instruction*> ops;
+    for (ir::value* op : current->ops())
+      if (auto* x = dynamic_cast<ir::instruction*>(op))
+        ops.push_back(x);
+    current->erase_from_parent();
+    erased.insert(current);
+    worklist.insert(worklist.end(), ops.begin(), ops.end());
+  }
+}
+
+void unmask::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  std::vector<ir::instruction*> to_rewrite;
+  for (ir::function* fn : mod.get_function_list())
+    for (ir::basic_block* block : fn->blocks())
+      for (ir::instruction* i : block->get_inst_list()) {
+        if (auto* x = dynamic_cast<ir::masked_load_inst*>(i))
+          if (range_->is_true(x->get_mask_operand()))
+            to_rewrite.push_back(i);
+        if (auto* x = dynamic_cast<ir::masked_store_inst*>(i))
+          if (range_->is_true(x->get_mask_operand()))
+            to_rewrite.push_back(i);
+      }
+
+  for (ir::instruction* i : to_rewrite) {
+    builder.set_insert_point(i);
+    ir::instruction* result = nullptr;
+    ir::value* mask = nullptr;
+    if (auto* x = dynamic_cast<ir::masked_load_inst*>(i)) {
+      mask = x->get_mask_operand();
+      result = builder.insert(
+          ir::unmasked_load_inst::create(x->get_pointer_operand()));
+    } else {
+      auto* y = static_cast<ir::masked_store_inst*>(i);
+      mask = y->get_mask_operand();
+      result = builder.insert(ir::unmasked_store_inst::create(
+          y->get_pointer_operand(), y->get_value_operand()));
+    }
+    result->set_name(i->get_name());
+    for (const auto& md : i->get_metadatas())
+      result->set_metadata(md.first, md.second);
+    i->replace_all_uses_with(result);
+    i->erase_from_parent();
+    if (auto* x = dynamic_cast<ir::instruction*>(mask))
+      erase_dead(x);
+  }
+}
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
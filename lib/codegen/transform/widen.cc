@@ -0,0 +1,191 @@
+#include "tensorscript/codegen/transform/widen.h"
+
+#include <vector>
+
+#include "tensorscript/codegen/analysis/range.h"
+#include "tensorscript/ir/basic_block.h"
+#include "tensorscript/ir/builder.h"
+#include "tensorscript/ir/constant.h"
+#include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
+#include "tensorscript/ir/module.h"
+
+namespace tensorscript {
+namespace codegen {
+namespace transform {
+
+static bool is_narrow_int(ir::type* ty) {
+  ir::type* scalar_ty = ty->get_scalar_ty();
+  return scalar_ty->is_integer_ty() &&
+         scalar_ty->get_integer_bitwidth() < 64;
+}
+
+// instructions recomputed in 64-bit; other values are sign-extended
+bool widen::is_widenable(ir::instruction* i) {
+  if (!is_narrow_int(i->get_type()))
+    return false;
+  if (auto* x = dynamic_cast<ir::binary_operator*>(i)) {
+    switch (x->get_op()) {
+      case ir::Add:
+      case ir::Sub:
+      case ir::Mul:
+      case ir::Shl:
+      case ir::SDiv:
+      case ir::SRem:
+      case ir::And:
+      case ir::Or:
+      case ir::Xor:
+        return true;
+      default:
+        return false;
+    }
+  }
+  switch (i->get_id()) {
+    case ir::INST_PHI:
+    case ir::INST_SPLAT:
+    case ir::INST_BROADCAST:
+    case ir::INST_RESHAPE:
+    case ir::INST_GET_PROGRAM_ID:
+    case ir::INST_GET_NUM_PROGRAMS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// whether the 32-bit computation of v gives the same result as the 64-bit
+// one, i.e., no arithmetic in it can wrap around
+bool widen::is_safe(ir::value* v, std::set<ir::value*>& seen) {
+  if (!seen.insert(v).second)
+    return true;
+  auto* i = dynamic_cast<ir::instruction*>(v);
+  if (!i || !is_widenable(i))
+    return true;
+  if (dynamic_cast<ir::binary_operator*>(i)) {
+    // ranges that may wrap around are those of their type
+    unsigned bits = i->get_type()->get_scalar_ty()->get_integer_bitwidth();
+    int64_t max = (int64_t(1) << (bits - 1)) - 1;
+    analysis::range::interval_t r = range_->get(i);
+    if (r.lo <= -max - 1 || r.hi >= max)
+      return false;
+  }
+  for (ir::value* op : i->ops())
+    if (!is_safe(op, seen))
+      return false;
+  return true;
+}
+
+ir::value* widen::get_wide(ir::value* v, ir::function* fn,
+                           ir::builder& builder) {
+  auto it = wide_.find(v);
+  if (it != wide_.end())
+    return it->second;
+  ir::context& ctx = v->get_type()->get_context();
+  ir::type* int64_ty = ir::type::get_int64_ty(ctx);
+  ir::type* ty = v->get_type();
+  ir::type* wide_ty =
+      ty->is_tile_ty() ? ir::tile_type::get_same_shapes(int64_ty, ty)
+                       : int64_ty;
+  ir::value* result = nullptr;
+  if (auto* x = dynamic_cast<ir::constant_int*>(v)) {
+    unsigned bits = ty->get_integer_bitwidth();
+    uint64_t value = x->get_value();
+    if ((value >> (bits - 1)) & 1)
+      value |= ~uint64_t(0) << bits;
+    result = ir::constant_int::get(int64_ty, value);
+  } else if (auto* phi = dynamic_cast<ir::phi_node*>(v)) {
+    builder.set_insert_point(phi->get_parent()->get_first_non_phi());
+    ir::phi_node* wide_phi =
+        builder.create_phi(wide_ty, phi->get_num_incoming(), phi->get_name());
+    // incoming values may depend on the phi node itself
+    wide_[v] = wide_phi;
+    for (unsigned n = 0; n < phi->get_num_incoming(); n++)
+      wide_phi->add_incoming(get_wide(phi->get_incoming_value(n), fn, builder),
+                             phi->get_incoming_block(n));
+    return wide_phi;
+  } else if (auto* i = dynamic_cast<ir::instruction*>(v)) {
+    if (!is_widenable(i)) {
+      builder.set_insert_point_after(i);
+      result = builder.create_int_cast(i, wide_ty, true);
+    } else if (auto* x = dynamic_cast<ir::binary_operator*>(i)) {
+      ir::value* lhs = get_wide(x->get_operand(0), fn, builder);
+      ir::value* rhs = get_wide(x->get_operand(1), fn, builder);
+      builder.set_insert_point_after(i);
+      result = builder.insert(ir::binary_operator::create(x->get_op(), lhs,
+                                                          rhs),
+                              i->get_name());
+    } else if (auto* x = dynamic_cast<ir::get_program_id_inst*>(i)) {
+      builder.set_insert_point_after(i);
+      result = builder.insert(
+          ir::get_program_id_inst::create(int64_ty, x->get_axis()),
+          i->get_name());
+    } else if (auto* x = dynamic_cast<ir::get_num_program_inst*>(i)) {
+      builder.set_insert_point_after(i);
+      result = builder.insert(
+          ir::get_num_program_inst::create(int64_ty, x->get_axis()),
+          i->get_name());
+    } else {
+      ir::value* arg = get_wide(i->get_operand(0), fn, builder);
+      const ir::type::tile_shapes_t& shapes = ty->get_tile_shapes();
+      builder.set_insert_point_after(i);
+      if (i->get_id() == ir::INST_SPLAT)
+        result = builder.create_splat(arg, shapes);
+      else if (i->get_id() == ir::INST_BROADCAST)
+        result = builder.create_broadcast(arg, shapes);
+      else
+        result = builder.create_reshape(arg, shapes);
+    }
+  } else {
+    // arguments are extended on entry
+    builder.set_insert_point(fn->blocks()[0]->get_first_non_phi());
+    result = builder.create_int_cast(v, wide_ty, true);
+  }
+  wide_[v] = result;
+  return result;
+}
+
+void widen::run(ir::function* fn, ir::builder& builder) {
+  std::vector<ir::getelementptr_inst*> geps;
+  std::vector<ir::icmp_inst*> cmps;
+  for (ir::basic_block* block : fn->blocks())
+    for (ir::instruction* i : block->get_inst_list()) {
+      if (auto* gep = dynamic_cast<ir::getelementptr_inst*>(i))
+        geps.push_back(gep);
+      if (auto* cmp = dynamic_cast<ir::icmp_inst*>(i))
+        cmps.push_back(cmp);
+    }
+  for (ir::getelementptr_inst* gep : geps)
+    for (unsigned k = 1; k < gep->get_num_operands(); k++) {
+      ir::value* idx = gep->get_operand(k);
+      std::set<ir::value*> seen;
+      if (!is_narrow_int(idx->get_type()) || is_safe(idx, seen))
+        continue;
+      gep->set_operand(k, get_wide(idx, fn, builder));
+    }
+  // comparisons of widened indices, e.g., bounds checks in masks, must see
+  // the same values as the addresses they guard
+  for (ir::icmp_inst* cmp : cmps) {
+    bool widened = false;
+    for (ir::value* op : cmp->ops()) {
+      std::set<ir::value*> seen;
+      widened |= wide_.count(op) && !is_safe(op, seen);
+    }
+    if (!widened || !is_narrow_int(cmp->get_operand(0)->get_type()))
+      continue;
+    for (unsigned k = 0; k < 2; k++)
+      cmp->set_operand(k, get_wide(cmp->get_operand(k), fn, builder));
+  }
+}
+
+void widen::run(ir::module& mod) {
+  if (index_bits_ < 64)
+    return;
+  ir::builder& builder = mod.get_builder();
+  for (ir::function* fn : mod.get_function_list())
+    run(fn, builder);
+  wide_.clear();
+}
+
+}  // namespace transform
+}  // namespace codegen
+}  // namespace tensorscript
@@ -76,12 +76,11 @@ std::vector<driver::device*> backend::devices::cache_;
 /*-----------------------------------*/
 
 void backend::modules::release() {
-  for (auto& x : cache_)
-    delete x.second;
-  cache_.clear();
+  cache_.clear([](driver::module*& x) { delete x; });
 }
 
-std::map<std::tuple<driver::stream*, std::string>, driver::module*>
+tools::sharded_map<std::tuple<driver::stream*, std::string>, driver::module*,
+                   backend::key_hash>
     backend::modules::cache_;
 
 /*-----------------------------------*/
@@ -89,22 +88,19 @@ std::map<std::tuple<driver::stream*, std::string>, driver::module*>
 /*-----------------------------------*/
 
 void backend::kernels::release() {
-  for (auto& x : cache_)
-    delete x.second;
-  cache_.clear();
+  cache_.clear([](driver::kernel*& x) { delete x; });
 }
 
 driver::kernel* backend::kernels::get(driver::module* mod,
                                       std::string const& name) {
   std::tuple<driver::module*, std::string> key(mod, name);
-  if (cache_.find(key) == cache_.end()) {
-    return &*cache_.insert({key, driver::kernel::create(mod, name.c_str())})
-                 .first->second;
-  }
-  return cache_.at(key);
+  return cache_.get_or_create(
+      key, [&]() { return driver::kernel::create(mod, name.c_str()); },
+      [](driver::kernel* x) { delete x; });
 }
 
-std::map<std::tuple<driver::module*, std::string>, driver::kernel*>
+tools::sharded_map<std::tuple<driver::module*, std::string>, driver::kernel*,
+                   backend::key_hash>
     backend::kernels::cache_;
 
 /*-----------------------------------*/
@@ -112,6 +108,7 @@ std::map<std::tuple<driver::module*, std::string>, driver::kernel*>
 /*-----------------------------------*/
 
 void backend::streams::init(std::list<driver::context*> const& contexts) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
   for (driver::context* ctx : contexts)
     if (cache_.find(ctx) == cache_.end())
       cache_.insert(std::make_pair(
@@ -119,6 +116,7 @@ void backend::streams::init(std::list<driver::context*> const& contexts) {
 }
 
 void backend::streams::release() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
   for (auto& x : cache_)
     for (auto& y : x.second)
       delete y;
@@ -131,32 +129,57 @@ driver::stream* backend::streams::get_default() {
 
 driver::stream* backend::streams::get(driver::context* context,
                                       unsigned int id) {
-  init(std::list<driver::context*>(1, context));
-  for (auto& x : cache_)
-    if (x.first == context)
-      return x.second[id];
-  throw;
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = cache_.find(context);
+  if (it == cache_.end()) {
+    lock.unlock();
+    init(std::list<driver::context*>(1, context));
+    lock.lock();
+    it = cache_.find(context);
+  }
+  if (id < it->second.size())
+    return it->second[id];
+  // create additional streams on demand
+  lock.unlock();
+  std::unique_lock<std::shared_mutex> write_lock(mutex_);
+  std::vector<driver::stream*>& cache = cache_.at(context);
+  while (cache.size() <= id)
+    cache.push_back(driver::stream::create(context));
+  return cache[id];
 }
 
 void backend::streams::get(driver::context* context,
                            std::vector<driver::stream*>& queues) {
+  // fast path: context already has streams
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = cache_.find(context);
+    if (it != cache_.end()) {
+      queues = it->second;
+      return;
+    }
+  }
   init(std::list<driver::context*>(1, context));
+  std::shared_lock<std::shared_mutex> lock(mutex_);
   queues = cache_.at(context);
 }
 
 std::map<driver::context*, std::vector<driver::stream*>>
     backend::streams::cache_;
+std::shared_mutex backend::streams::mutex_;
 
 /*-----------------------------------*/
 //------------  Contexts ------------*/
 /*-----------------------------------*/
 
 void backend::contexts::init(std::vector<driver::device*> const& devices) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
   for (driver::device* dvc : devices)
     cache_.push_back(driver::context::create(dvc));
 }
 
 void backend::contexts::release() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
   for (auto& x : cache_)
     delete x;
   cache_.clear();
@@ -164,36 +187,70 @@ void backend::contexts::release() {
 
 driver::context* backend::contexts::get_default() {
   backend::init();
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  if (default_device >= cache_.size())
+    throw std::runtime_error("Triton: invalid default device");
   auto it = cache_.begin();
   std::advance(it, default_device);
   return *it;
 }
 
+driver::context* backend::contexts::find(CUcontext ctx) {
+  for (driver::context* x : cache_) {
+    driver::cu_context* cu_x = (driver::cu_context*)x;
+    if (*cu_x->cu() == ctx)
+      return x;
+  }
+  return nullptr;
+}
+
+driver::context* backend::contexts::import(CUcontext ctx) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (driver::context* x = find(ctx))
+      return x;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (driver::context* x = find(ctx))
+    return x;
+  cache_.emplace_back(new driver::cu_context(ctx, false));
+  return cache_.back();
+}
+
 void backend::contexts::get(std::list<driver::context*>& contexts) {
   backend::init();
+  std::shared_lock<std::shared_mutex> lock(mutex_);
   contexts = cache_;
 }
 
 std::list<driver::context*> backend::contexts::cache_;
+std::shared_mutex backend::contexts::mutex_;
 
 /*-----------------------------------*/
 //------------  General -------------*/
 /*-----------------------------------*/
 
 void backend::synchronize(driver::context* context) {
-  for (driver::stream* queue : streams::cache_.at(context))
+  std::vector<driver::stream*> queues;
+  streams::get(context, queues);
+  for (driver::stream* queue : queues)
     queue->synchronize();
 }
 
 void backend::release() {
+  std::lock_guard<std::mutex> lock(init_mutex_);
   backend::kernels::release();
   //  backend::programs::release();
   backend::streams::release();
   backend::contexts::release();
+  initialized_.store(false, std::memory_order_release);
 }
 
 void backend::init() {
-  if (!contexts::cache_.empty())
+  if (initialized_.load(std::memory_order_acquire))
+    return;
+  std::lock_guard<std::mutex> lock(init_mutex_);
+  if (initialized_.load(std::memory_order_relaxed))
     return;
   // initialize platforms
   backend::platforms::init();
@@ -202,10 +259,18 @@ void backend::init() {
   // initialize contexts
   backend::contexts::init(devices::cache_);
   // initialize streams
-  streams::init(contexts::cache_);
+  std::list<driver::context*> contexts;
+  {
+    std::shared_lock<std::shared_mutex> lock(contexts::mutex_);
+    contexts = contexts::cache_;
+  }
+  streams::init(contexts);
+  initialized_.store(true, std::memory_order_release);
 }
 
 unsigned int backend::default_device = 0;
+std::atomic<bool> backend::initialized_(false);
+std::mutex backend::init_mutex_;
 
 }  // namespace driver
 
@@ -0,0 +1,238 @@
+#include "tensorscript/driver/compiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <exception>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "tensorscript/driver/context.h"
+#include "tensorscript/driver/kernel.h"
+#include "tensorscript/driver/module.h"
+
+namespace tensorscript {
+namespace driver {
+
+struct compile_job {
+  enum status_t { Queued, Running, Done };
+
+  compiler* owner;
+  driver::context* ctx;
+  codegen_fn_t codegen;
+  std::string name;
+  int priority;
+  size_t order;
+  std::atomic<status_t> status;
+  // results
+  std::shared_ptr<llvm::LLVMContext> llvm_ctx;
+  std::unique_ptr<driver::module> module;
+  std::unique_ptr<driver::kernel> kernel;
+  std::exception_ptr error;
+  // completion
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+/* ------------------------ */
+//       Async Kernel       //
+/* ------------------------ */
+
+async_kernel::async_kernel() {}
+
+bool async_kernel::valid() const { return job_ != nullptr; }
+
+bool async_kernel::ready() const {
+  if (!valid())
+    throw std::runtime_error("ready() on an empty async_kernel");
+  std::lock_guard<std::mutex> lock(job_->mutex);
+  return job_->status == compile_job::Done;
+}
+
+void async_kernel::wait() const {
+  if (!valid())
+    throw std::runtime_error("wait() on an empty async_kernel");
+  job_->owner->promote(*job_, INT_MAX);
+  // help the executor, so waiting from one of its tasks cannot deadlock
+  tools::executor* exec = job_->owner->get_executor();
+  std::unique_lock<std::mutex> lock(job_->mutex);
+  while (job_->status != compile_job::Done) {
+    lock.unlock();
+    bool ran = exec->run_pending();
+    lock.lock();
+    if (!ran)
+      job_->cv.wait_for(lock, std::chrono::microseconds(100), [this] {
+        return job_->status == compile_job::Done;
+      });
+  }
+}
+
+driver::kernel* async_kernel::get() const {
+  wait();
+  if (job_->error)
+    std::rethrow_exception(job_->error);
+  return job_->kernel.get();
+}
+
+driver::module* async_kernel::module() const {
+  wait();
+  if (job_->error)
+    std::rethrow_exception(job_->error);
+  return job_->module.get();
+}
+
+/* ------------------------ */
+//         Compiler         //
+/* ------------------------ */
+
+compiler::compiler(tools::executor* exec)
+    : exec_(exec), stop_(false), next_order_(0), num_tasks_(0) {
+  driver::module::init_llvm();
+}
+
+compiler::~compiler() {
+  // executor tasks reference this compiler
+  std::unique_lock<std::mutex> lock(mutex_);
+  stop_ = true;
+  cv_.wait(lock, [this] { return num_tasks_ == 0; });
+}
+
+async_kernel compiler::compile(driver::context* ctx, codegen_fn_t codegen,
+                               const std::string& name, int priority) {
+  std::shared_ptr<compile_job> job = std::make_shared<compile_job>();
+  job->owner = this;
+  job->ctx = ctx;
+  job->codegen = std::move(codegen);
+  job->name = name;
+  job->priority = priority;
+  job->status = compile_job::Queued;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_)
+      throw std::runtime_error("compile on stopped compiler");
+    job->order = next_order_++;
+    queue_.push_back(job);
+    num_tasks_++;
+  }
+  // one task per job; the task picks whichever job is most urgent by then
+  exec_->submit([this] { run_next(); });
+  async_kernel result;
+  result.job_ = job;
+  return result;
+}
+
+std::vector<async_kernel> compiler::compile_all(
+    driver::context* ctx, const std::vector<codegen_fn_t>& candidates,
+    const std::string& name, int priority) {
+  std::vector<async_kernel> result;
+  result.reserve(candidates.size());
+  for (const codegen_fn_t& codegen : candidates)
+    result.push_back(compile(ctx, codegen, name, priority));
+  return result;
+}
+
+void compiler::promote(compile_job& job, int priority) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (job.status == compile_job::Queued)
+    job.priority = std::max(job.priority, priority);
+}
+
+void compiler::run(compile_job& job) {
+  try {
+    job.llvm_ctx = std::make_shared<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> src = job.codegen(*job.llvm_ctx);
+    job.module.reset(driver::module::create(job.ctx, std::move(src)));
+    // the JIT keeps referencing the llvm module
+    if (job.module->backend() == Host)
+      job.module->hst()->llvm_ctx = job.llvm_ctx;
+    else
+      job.llvm_ctx.reset();
+    job.kernel.reset(
+        driver::kernel::create(job.module.get(), job.name.c_str()));
+  } catch (...) {
+    job.error = std::current_exception();
+  }
+}
+
+void compiler::run_next() {
+  std::shared_ptr<compile_job> job;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // highest priority first, then submission order
+    auto it = std::min_element(
+        queue_.begin(), queue_.end(),
+        [](const std::shared_ptr<compile_job>& x,
+           const std::shared_ptr<compile_job>& y) {
+          if (x->priority != y->priority)
+            return x->priority > y->priority;
+          return x->order < y->order;
+        });
+    job = *it;
+    queue_.erase(it);
+    job->status = compile_job::Running;
+  }
+  run(*job);
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->status = compile_job::Done;
+  }
+  job->cv.notify_all();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--num_tasks_ == 0)
+    cv_.notify_all();
+}
+
+compiler* compiler::get_default() {
+  static compiler result;
+  return &result;
+}
+
+/* ------------------------ */
+//    Specialized Kernel    //
+/* ------------------------ */
+
+specialized_kernel::specialized_kernel(
+    compiler* comp, driver::context* ctx, codegen_fn_t codegen,
+    const std::string& name, const std::vector<uint8_t>& specializable)
+    : compiler_(comp),
+      ctx_(ctx),
+      codegen_(std::move(codegen)),
+      name_(name),
+      specializable_(specializable) {}
+
+codegen::specialization_key_t specialized_kernel::get_key(
+    const std::vector<uint64_t>& args) const {
+  codegen::specialization_key_t result(args.size(), codegen::arg_generic);
+  for (size_t i = 0; i < args.size() && i < specializable_.size(); i++) {
+    uint8_t mask = specializable_[i];
+    if ((mask & codegen::arg_equal_to_1) && args[i] == 1)
+      result[i] = codegen::arg_equal_to_1;
+    else if ((mask & codegen::arg_divisible_by_16) && args[i] % 16 == 0)
+      result[i] = codegen::arg_divisible_by_16;
+  }
+  return result;
+}
+
+async_kernel specialized_kernel::get(const std::vector<uint64_t>& args) {
+  codegen::specialization_key_t key = get_key(args);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = variants_.find(key);
+  if (it != variants_.end())
+    return it->second;
+  codegen_fn_t codegen = codegen_;
+  async_kernel result = compiler_->compile(
+      ctx_,
+      [codegen, key](llvm::LLVMContext& ctx) { return codegen(ctx, key); },
+      name_);
+  variants_.emplace(key, result);
+  return result;
+}
+
+size_t specialized_kernel::num_variants() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return variants_.size();
+}
+
+}  // namespace driver
+}  // namespace tensorscript
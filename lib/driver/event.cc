@@ -3,7 +3,16 @@
 namespace tensorscript {
 namespace driver {
 
+event::event() : hst_(new host_event_t()) {}
+
 float event::elapsed_time() const {
+  {
+    std::lock_guard<std::mutex> lock(hst_->mutex);
+    if (hst_->recorded) {
+      std::chrono::duration<float, std::milli> ms = hst_->end - hst_->start;
+      return ms.count();
+    }
+  }
   float time;
   dispatch::cuEventElapsedTime(&time, cu_->first, cu_->second);
   return time;
@@ -11,5 +20,52 @@ float event::elapsed_time() const {
 
 handle<cu_event_t> const& event::cu() const { return cu_; }
 
+std::shared_ptr<host_event_t> const& event::hst() const { return hst_; }
+
+void event::reset() {
+  std::lock_guard<std::mutex> lock(hst_->mutex);
+  hst_->done = false;
+}
+
+void event::record_start() {
+  std::lock_guard<std::mutex> lock(hst_->mutex);
+  hst_->recorded = true;
+  hst_->start = host_event_t::clock_t::now();
+}
+
+void event::record_end() {
+  std::vector<std::function<void()>> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(hst_->mutex);
+    hst_->end = host_event_t::clock_t::now();
+    hst_->done = true;
+    callbacks.swap(hst_->callbacks);
+  }
+  hst_->cv.notify_all();
+  for (auto& fn : callbacks)
+    fn();
+}
+
+bool event::query() const {
+  std::lock_guard<std::mutex> lock(hst_->mutex);
+  return hst_->done;
+}
+
+void event::synchronize() const {
+  std::unique_lock<std::mutex> lock(hst_->mutex);
+  hst_->cv.wait(lock, [this] { return hst_->done; });
+}
+
+void event::then(std::function<void()> fn) const {
+  {
+    std::lock_guard<std::mutex> lock(hst_->mutex);
+    if (!hst_->done) {
+      hst_->callbacks.push_back(std::move(fn));
+      return;
+    }
+  }
+  fn();
+}
+
 }  // namespace driver
 }  // namespace tensorscript
@@ -64,6 +64,10 @@ void host_kernel::setArg(unsigned int index, driver::buffer* buffer) {
 
 const std::vector<void*>& host_kernel::params() { return params_; }
 
+const std::vector<std::shared_ptr<void> >& host_kernel::params_store() {
+  return params_store_;
+}
+
 /* ------------------------ */
 //         OpenCL           //
 /* ------------------------ */
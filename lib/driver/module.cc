@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <memory>
+#include <mutex>
 
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
@@ -10,6 +11,7 @@
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
@@ -28,15 +30,22 @@ namespace driver {
 /* ------------------------ */
 
 void module::init_llvm() {
-  static bool init = false;
-  if (!init) {
+  static std::once_flag init;
+  std::call_once(init, []() {
     llvm::InitializeAllTargetInfos();
     llvm::InitializeAllTargets();
     llvm::InitializeAllTargetMCs();
     llvm::InitializeAllAsmParsers();
     llvm::InitializeAllAsmPrinters();
-    init = true;
-  }
+    // 32-bit pointers for shared memory. set once here: cl::opt values are
+    // process-wide and must not be mutated while other threads compile
+    auto options = llvm::cl::getRegisteredOptions();
+    if (options.count("nvptx-short-ptr")) {
+      auto* short_ptr =
+          static_cast<llvm::cl::opt<bool>*>(options["nvptx-short-ptr"]);
+      short_ptr->setValue(true);
+    }
+  });
 }
 
 module::module(driver::context* ctx, CUmodule mod,
@@ -88,9 +97,12 @@ void module::compile_llvm_module(std::unique_ptr<llvm::Module> module,
   opt.UnsafeFPMath = false;
   opt.NoInfsFPMath = false;
   opt.NoNaNsFPMath = true;
-  llvm::TargetMachine* machine = target->createTargetMachine(
+  if (!target)
+    throw std::runtime_error(error);
+  // one machine per compilation, so concurrent compilations share nothing
+  std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
       module->getTargetTriple(), proc, features, opt, llvm::Reloc::PIC_,
-      llvm::None, llvm::CodeGenOpt::Aggressive);
+      llvm::None, llvm::CodeGenOpt::Aggressive));
   // set data layout
   if (layout.empty())
     module->setDataLayout(machine->createDataLayout());
@@ -130,9 +142,11 @@ host_module::host_module(driver::context* context,
   llvm::LLVMContext& ctx = src->getContext();
   llvm::Type* void_ty = llvm::Type::getVoidTy(ctx);
   llvm::Type* args_ty = llvm::Type::getInt8PtrTy(ctx)->getPointerTo();
-  llvm::Type* int32_ty = llvm::Type::getInt32Ty(ctx);
+  // grid coordinates are passed as 64-bit integers and narrowed to the
+  // width the kernel indexes with
+  llvm::Type* int64_ty = llvm::Type::getInt64Ty(ctx);
   llvm::FunctionType* main_ty = llvm::FunctionType::get(
-      void_ty, {args_ty, int32_ty, int32_ty, int32_ty}, false);
+      void_ty, {args_ty, int64_ty, int64_ty, int64_ty}, false);
   llvm::Function* main = llvm::Function::Create(
       main_ty, llvm::Function::ExternalLinkage, "main", &*src);
   llvm::Function* fn = src->getFunction("matmul");
@@ -149,9 +163,11 @@ host_module::host_module(driver::context* context,
         ir_builder.CreateLoad(ptrs[i]), fn_ty->getParamType(i)->getPointerTo());
     fn_args[i] = ir_builder.CreateLoad(addr);
   }
-  fn_args[fn_args.size() - 3] = main->arg_begin() + 1;
-  fn_args[fn_args.size() - 2] = main->arg_begin() + 2;
-  fn_args[fn_args.size() - 1] = main->arg_begin() + 3;
+  for (unsigned i = 0; i < 3; i++) {
+    unsigned n = fn_args.size() - 3 + i;
+    fn_args[n] = ir_builder.CreateZExtOrTrunc(main->arg_begin() + 1 + i,
+                                              fn_ty->getParamType(n));
+  }
   ir_builder.CreateCall(fn, fn_args);
   ir_builder.CreateRetVoid();
 
@@ -225,14 +241,6 @@ static bool find_and_replace(std::string& str, const std::string& begin,
 
 std::string cu_module::compile_llvm_module(std::unique_ptr<llvm::Module> module,
                                            driver::device* device) {
-  // options
-  auto options = llvm::cl::getRegisteredOptions();
-  //   for(auto& opt: options)
-  //     std::cout << opt.getKey().str() << std::endl;
-  auto* short_ptr =
-      static_cast<llvm::cl::opt<bool>*>(options["nvptx-short-ptr"]);
-  assert(short_ptr);
-  short_ptr->setValue(true);
   // compute capability
   auto cc = ((driver::cu_device*)device)->compute_capability();
   std::string sm = "sm_" + std::to_string(cc.first) + std::to_string(cc.second);
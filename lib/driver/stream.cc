@@ -2,6 +2,7 @@
 
 #include <array>
 #include <cassert>
+#include <cstring>
 
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
@@ -11,6 +12,7 @@
 #include "tensorscript/driver/device.h"
 #include "tensorscript/driver/event.h"
 #include "tensorscript/driver/kernel.h"
+#include "tensorscript/tools/thread_pool.h"
 
 namespace tensorscript {
 
@@ -49,32 +51,134 @@ driver::context* stream::context() const { return ctx_; }
 /* ------------------------ */
 
 host_stream::host_stream(driver::context* ctx)
-    : stream(ctx, host_stream_t(), true) {}
+    : stream(ctx, host_stream_t(), true), queue_(new queue_t()) {}
 
-void host_stream::synchronize() {}
+host_stream::~host_stream() {
+  // commands deferred on another stream are left to their event
+  std::unique_lock<std::mutex> lock(queue_->mutex);
+  queue_->cv.wait(lock,
+                  [this] { return !queue_->running || queue_->deferred; });
+}
+
+void host_stream::push(std::function<void()> fn,
+                       std::vector<event> const* deps, event* event) {
+  command_t cmd;
+  cmd.fn = std::move(fn);
+  if (deps)
+    cmd.deps = *deps;
+  if (event) {
+    event->reset();
+    cmd.signal.push_back(*event);
+  }
+  std::lock_guard<std::mutex> lock(queue_->mutex);
+  queue_->commands.push_back(std::move(cmd));
+  if (!queue_->running) {
+    queue_->running = true;
+    std::shared_ptr<queue_t> queue = queue_;
+    tools::get_executor()->submit([queue] { drain(queue); });
+  }
+}
+
+void host_stream::drain(const std::shared_ptr<queue_t>& queue) {
+  while (true) {
+    command_t* cmd;
+    {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      queue->deferred = false;
+      if (queue->commands.empty()) {
+        queue->running = false;
+        queue->cv.notify_all();
+        return;
+      }
+      cmd = &queue->commands.front();
+    }
+    // wait for events of other streams without holding a worker
+    for (const event& dep : cmd->deps)
+      if (!dep.query()) {
+        {
+          std::lock_guard<std::mutex> lock(queue->mutex);
+          queue->deferred = true;
+          queue->cv.notify_all();
+        }
+        dep.then([queue] {
+          tools::get_executor()->submit([queue] { drain(queue); });
+        });
+        return;
+      }
+    for (event& ev : cmd->signal)
+      ev.record_start();
+    try {
+      cmd->fn();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      if (!queue->error)
+        queue->error = std::current_exception();
+    }
+    for (event& ev : cmd->signal)
+      ev.record_end();
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->commands.pop_front();
+  }
+}
+
+void host_stream::synchronize() {
+  std::unique_lock<std::mutex> lock(queue_->mutex);
+  queue_->cv.wait(lock, [this] { return !queue_->running; });
+  if (queue_->error) {
+    std::exception_ptr error = queue_->error;
+    queue_->error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
 
 void host_stream::enqueue(driver::kernel* kernel, std::array<size_t, 3> grid,
                           std::array<size_t, 3> block,
-                          std::vector<event> const*, event* event) {
+                          std::vector<event> const* deps, event* event) {
   driver::host_kernel* hst_kernel = (host_kernel*)kernel;
   llvm::ExecutionEngine* engine = kernel->module()->hst()->engine;
-  void (*fn)(char**, int32_t, int32_t, int32_t) = (void (*)(
-      char**, int32_t, int32_t, int32_t))engine->getFunctionAddress("main");
-  for (size_t i = 0; i < grid[0]; i++)
-    for (size_t j = 0; j < grid[1]; j++)
-      for (size_t k = 0; k < grid[2]; k++)
-        fn((char**)hst_kernel->params().data(), int32_t(i), int32_t(j),
-           int32_t(k));
+  typedef void (*fn_t)(char**, int64_t, int64_t, int64_t);
+  fn_t fn = (fn_t)engine->getFunctionAddress("main");
+  // arguments may be overwritten before the launch runs
+  std::vector<std::shared_ptr<void>> store = hst_kernel->params_store();
+  push(
+      [fn, grid, store]() {
+        std::vector<void*> params(store.size());
+        for (size_t n = 0; n < store.size(); n++)
+          params[n] = store[n].get();
+        size_t num_blocks = grid[0] * grid[1] * grid[2];
+        tools::executor* exec = tools::get_executor();
+        size_t grain =
+            std::max<size_t>(1, num_blocks / (4 * exec->num_threads()));
+        tools::parallel_for(
+            0, num_blocks, grain,
+            [&](size_t lo, size_t hi) {
+              for (size_t id = lo; id < hi; id++) {
+                size_t i = id % grid[0];
+                size_t j = id / grid[0] % grid[1];
+                size_t k = id / (grid[0] * grid[1]);
+                fn((char**)params.data(), int64_t(i), int64_t(j),
+                   int64_t(k));
+              }
+            },
+            exec);
+      },
+      deps, event);
 }
 
 void host_stream::write(driver::buffer* buffer, bool blocking,
                         std::size_t offset, std::size_t size, void const* ptr) {
-  std::memcpy((void*)buffer->hst()->data, ptr, size);
+  char* dst = buffer->hst()->data + offset;
+  push([dst, ptr, size]() { std::memcpy(dst, ptr, size); }, NULL, NULL);
+  if (blocking)
+    synchronize();
 }
 
 void host_stream::read(driver::buffer* buffer, bool blocking,
                        std::size_t offset, std::size_t size, void* ptr) {
-  std::memcpy(ptr, (const void*)buffer->hst()->data, size);
+  const char* src = buffer->hst()->data + offset;
+  push([src, ptr, size]() { std::memcpy(ptr, src, size); }, NULL, NULL);
+  if (blocking)
+    synchronize();
 }
 
 /* ------------------------ */
@@ -1,5 +1,8 @@
 #include "tensorscript/ir/basic_block.h"
 
+#include <algorithm>
+#include <cassert>
+
 #include "tensorscript/ir/function.h"
 #include "tensorscript/ir/instructions.h"
 #include "tensorscript/ir/type.h"
@@ -9,16 +12,66 @@ namespace ir {
 
 class phi_node;
 
+/* Instruction list */
+inst_list::iterator inst_list::insert(iterator pos, instruction* i) {
+  assert(pos.get_list() == this && "insertion point is not in this list");
+  instruction* next = *pos;
+  instruction* prev = next ? next->prev_ : tail_;
+  i->prev_ = prev;
+  i->next_ = next;
+  (prev ? prev->next_ : head_) = i;
+  (next ? next->prev_ : tail_) = i;
+  i->set_parent(parent_);
+  size_++;
+  // appending keeps the numbering valid
+  if (order_valid_ && !next)
+    i->order_ = prev ? prev->order_ + 1 : 0;
+  else
+    order_valid_ = false;
+  return iterator(this, i);
+}
+
+inst_list::iterator inst_list::erase(iterator pos) {
+  instruction* i = *pos;
+  assert((i->prev_ || head_ == i) && "instruction is not in this list");
+  instruction* prev = i->prev_;
+  instruction* next = i->next_;
+  (prev ? prev->next_ : head_) = next;
+  (next ? next->prev_ : tail_) = prev;
+  i->prev_ = nullptr;
+  i->next_ = nullptr;
+  i->set_parent(nullptr);
+  size_--;
+  return iterator(this, next);
+}
+
+void inst_list::renumber() {
+  unsigned order = 0;
+  for (instruction* i = head_; i; i = i->next_)
+    i->order_ = order++;
+  order_valid_ = true;
+}
+
+bool inst_list::comes_before(const instruction* a, const instruction* b) {
+  if (!order_valid_)
+    renumber();
+  return a->order_ < b->order_;
+}
+
+/* Basic Block */
 basic_block::basic_block(context& ctx, const std::string& name,
                          function* parent)
-    : value(type::get_label_ty(ctx), name), ctx_(ctx), parent_(parent) {
+    : value(type::get_label_ty(ctx), name),
+      ctx_(ctx),
+      parent_(parent),
+      inst_list_(this) {
   if (parent_)
     parent_->insert_block(this);
 }
 
 basic_block* basic_block::create(context& ctx, const std::string& name,
                                  function* parent) {
-  return new basic_block(ctx, name, parent);
+  return new (ctx) basic_block(ctx, name, parent);
 }
 
 void basic_block::add_predecessor(basic_block* pred) {
@@ -27,6 +80,17 @@ void basic_block::add_predecessor(basic_block* pred) {
     pred->succs_.push_back(this);
 }
 
+void basic_block::remove_predecessor(basic_block* pred) {
+  auto it = std::find(preds_.begin(), preds_.end(), pred);
+  if (it == preds_.end())
+    return;
+  preds_.erase(it);
+  if (pred) {
+    auto& succs = pred->succs_;
+    succs.erase(std::find(succs.begin(), succs.end(), this));
+  }
+}
+
 basic_block::iterator basic_block::get_first_non_phi() {
   auto it = begin();
   for (; it != end(); it++)
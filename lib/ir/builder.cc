@@ -12,26 +12,22 @@ namespace tensorscript {
 namespace ir {
 
 builder::builder(context& ctx)
-    : ctx_(ctx), block_(nullptr), insert_point_(nullptr) {}
+    : ctx_(ctx), block_(nullptr), insert_point_() {}
 
 //===----------------------------------------------------------------------===//
 //                               utilities
 //===----------------------------------------------------------------------===//
 void builder::set_insert_point(basic_block::iterator it) {
-  block_ = (*it)->get_parent();
+  block_ = it.get_list()->get_parent();
   insert_point_ = it;
 }
 
 void builder::set_insert_point(instruction* i) {
-  block_ = i->get_parent();
-  auto it = std::find(block_->begin(), block_->end(), i);
-  set_insert_point(it);
+  set_insert_point(i->get_parent()->iterator_to(i));
 }
 
 void builder::set_insert_point_after(instruction* i) {
-  block_ = i->get_parent();
-  auto it = std::find(block_->begin(), block_->end(), i);
-  set_insert_point(++it);
+  set_insert_point(++i->get_parent()->iterator_to(i));
 }
 
 void builder::set_insert_point(basic_block* block) {
@@ -0,0 +1,900 @@
+#include "tensorscript/ir/bytecode.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "tensorscript/ir/basic_block.h"
+#include "tensorscript/ir/constant.h"
+#include "tensorscript/ir/context.h"
+#include "tensorscript/ir/function.h"
+#include "tensorscript/ir/instructions.h"
+#include "tensorscript/ir/module.h"
+#include "tensorscript/ir/type.h"
+
+namespace tensorscript {
+namespace ir {
+
+namespace {
+
+const char bytecode_magic[4] = {'T', 'S', 'B', 'C'};
+
+// kinds of operand references
+enum ref_kind_t {
+  REF_LOCAL,      // argument, block or instruction of the current function
+  REF_GLOBAL,     // function or alloc_const of the module
+  REF_INT,        // constant_int
+  REF_FP,         // constant_fp
+  REF_UNDEF,      // undef_value
+  REF_RANGE_STA,  // make_range_sta of a local make_range
+};
+
+//===----------------------------------------------------------------------===//
+//                               encoding
+//===----------------------------------------------------------------------===//
+
+void put_varint(std::string& os, uint64_t x) {
+  while (x >= 0x80) {
+    os.push_back(char((x & 0x7f) | 0x80));
+    x >>= 7;
+  }
+  os.push_back(char(x));
+}
+
+void put_u64(std::string& os, uint64_t x) {
+  for (unsigned i = 0; i < 8; i++)
+    os.push_back(char((x >> (8 * i)) & 0xff));
+}
+
+void put_string(std::string& os, const std::string& str) {
+  put_varint(os, str.size());
+  os.append(str);
+}
+
+class writer {
+ public:
+  explicit writer(module& mod) : mod_(mod), num_types_(0) {}
+  void write(std::ostream& os);
+
+ private:
+  unsigned get_type_id(type* ty);
+  void write_local(std::string& os, value* v);
+  void write_ref(std::string& os, value* v);
+  void write_instruction(std::string& os, instruction* inst);
+  void write_body(std::string& os, function* fn);
+
+ private:
+  module& mod_;
+  // types, in dependency order
+  std::string types_;
+  unsigned num_types_;
+  std::map<type*, unsigned> type_ids_;
+  // module-level values: functions, then allocs
+  std::map<value*, unsigned> global_ids_;
+  // values of the function being written; ids at or after current_ are
+  // forward references
+  std::map<value*, unsigned> local_ids_;
+  unsigned current_;
+};
+
+unsigned writer::get_type_id(type* ty) {
+  auto it = type_ids_.find(ty);
+  if (it != type_ids_.end())
+    return it->second;
+  // contained types are written first
+  std::string entry;
+  put_varint(entry, ty->get_type_id());
+  switch (ty->get_type_id()) {
+    case type::VoidTyID:
+    case type::HalfTyID:
+    case type::FloatTyID:
+    case type::DoubleTyID:
+    case type::LabelTyID:
+      break;
+    case type::IntegerTyID:
+      put_varint(entry, ty->get_integer_bitwidth());
+      break;
+    case type::PointerTyID:
+      put_varint(entry, get_type_id(ty->get_pointer_element_ty()));
+      put_varint(entry, ty->get_pointer_address_space());
+      break;
+    case type::TileTyID: {
+      put_varint(entry, get_type_id(ty->get_scalar_ty()));
+      const type::tile_shapes_t& shapes = ty->get_tile_shapes();
+      put_varint(entry, shapes.size());
+      for (unsigned shape : shapes)
+        put_varint(entry, shape);
+      break;
+    }
+    case type::FunctionTyID: {
+      function_type* fn_ty = (function_type*)ty;
+      put_varint(entry, get_type_id(fn_ty->get_return_ty()));
+      put_varint(entry, fn_ty->get_num_params());
+      for (unsigned i = 0; i < fn_ty->get_num_params(); i++)
+        put_varint(entry, get_type_id(fn_ty->get_param_ty(i)));
+      break;
+    }
+    default:
+      throw std::runtime_error("bytecode: unsupported type " + ty->repr());
+  }
+  types_.append(entry);
+  return type_ids_[ty] = num_types_++;
+}
+
+void writer::write_local(std::string& os, value* v) {
+  auto it = local_ids_.find(v);
+  if (it == local_ids_.end())
+    throw std::runtime_error("bytecode: operand " + v->get_name() +
+                             " is not defined in this function");
+  put_varint(os, it->second);
+  // the reader needs the type of a value it has not seen yet
+  if (it->second >= current_)
+    put_varint(os, get_type_id(v->get_type()));
+}
+
+void writer::write_ref(std::string& os, value* v) {
+  if (!v)
+    throw std::runtime_error("bytecode: null operand");
+  if (auto* x = dynamic_cast<constant_int*>(v)) {
+    put_varint(os, REF_INT);
+    put_varint(os, get_type_id(x->get_type()));
+    put_varint(os, x->get_value());
+  } else if (auto* x = dynamic_cast<constant_fp*>(v)) {
+    double value = x->get_value();
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_varint(os, REF_FP);
+    put_varint(os, get_type_id(x->get_type()));
+    put_u64(os, bits);
+  } else if (dynamic_cast<undef_value*>(v)) {
+    put_varint(os, REF_UNDEF);
+    put_varint(os, get_type_id(v->get_type()));
+  } else if (auto* x = dynamic_cast<make_range_sta*>(v)) {
+    put_varint(os, REF_RANGE_STA);
+    write_local(os, x->get_range());
+  } else if (global_ids_.count(v)) {
+    put_varint(os, REF_GLOBAL);
+    put_varint(os, global_ids_.at(v));
+  } else {
+    put_varint(os, REF_LOCAL);
+    write_local(os, v);
+  }
+}
+
+void writer::write_instruction(std::string& os, instruction* inst) {
+  put_varint(os, inst->get_id());
+  put_varint(os, get_type_id(inst->get_type()));
+  put_string(os, inst->get_name());
+  put_varint(os, inst->get_num_operands());
+  for (value* op : inst->ops())
+    write_ref(os, op);
+  // state that is not carried by the operands
+  switch (inst->get_id()) {
+    case INST_PHI: {
+      phi_node* phi = (phi_node*)inst;
+      for (unsigned i = 0; i < phi->get_num_incoming(); i++)
+        write_local(os, phi->get_incoming_block(i));
+      break;
+    }
+    case INST_BINOP: {
+      binary_operator* binop = (binary_operator*)inst;
+      put_varint(os, binop->get_op());
+      put_varint(os, binop->has_no_unsigned_wrap_ |
+                         (binop->has_no_signed_wrap_ << 1));
+      break;
+    }
+    case INST_ICMP:
+    case INST_FCMP:
+      put_varint(os, ((cmp_inst*)inst)->get_pred());
+      break;
+    case INST_GET_PROGRAM_ID:
+      put_varint(os, ((get_program_id_inst*)inst)->get_axis());
+      break;
+    case INST_GET_NUM_PROGRAMS:
+      put_varint(os, ((get_num_program_inst*)inst)->get_axis());
+      break;
+    case INST_REDUCE:
+      put_varint(os, ((reduce_inst*)inst)->get_op());
+      put_varint(os, ((reduce_inst*)inst)->get_axis());
+      break;
+    case INST_TRANS: {
+      std::vector<int> perm = ((trans_inst*)inst)->get_perm();
+      put_varint(os, perm.size());
+      for (int x : perm)
+        put_varint(os, x);
+      break;
+    }
+    case INST_MAKE_RANGE: {
+      make_range* range = (make_range*)inst;
+      write_ref(os, const_cast<constant_int*>(range->get_first()));
+      write_ref(os, const_cast<constant_int*>(range->get_last()));
+      break;
+    }
+    default:
+      if (auto* cast = dynamic_cast<cast_inst*>(inst))
+        put_varint(os, cast->get_op());
+      break;
+  }
+  // metadata
+  const auto& metadatas = inst->get_metadatas();
+  put_varint(os, metadatas.size());
+  for (const auto& x : metadatas) {
+    put_varint(os, x.first);
+    put_varint(os, x.second);
+  }
+}
+
+void writer::write_body(std::string& os, function* fn) {
+  // number arguments, blocks and instructions
+  local_ids_.clear();
+  for (argument* arg : fn->args())
+    local_ids_.emplace(arg, local_ids_.size());
+  for (basic_block* block : fn->blocks())
+    local_ids_.emplace(block, local_ids_.size());
+  for (basic_block* block : fn->blocks())
+    for (instruction* inst : block->get_inst_list())
+      local_ids_.emplace(inst, local_ids_.size());
+  current_ = local_ids_.size();
+  // blocks
+  put_varint(os, fn->blocks().size());
+  for (basic_block* block : fn->blocks())
+    put_string(os, block->get_name());
+  for (basic_block* block : fn->blocks()) {
+    put_varint(os, block->get_predecessors().size());
+    for (basic_block* pred : block->get_predecessors())
+      write_local(os, pred);
+  }
+  // instructions
+  current_ = fn->args().size() + fn->blocks().size();
+  for (basic_block* block : fn->blocks()) {
+    put_varint(os, block->get_inst_list().size());
+    for (instruction* inst : block->get_inst_list()) {
+      write_instruction(os, inst);
+      current_++;
+    }
+  }
+}
+
+void writer::write(std::ostream& os) {
+  std::string header, functions, allocs, globals, metadatas, bodies;
+  // module-level values
+  for (function* fn : mod_.get_function_list())
+    global_ids_.emplace(fn, global_ids_.size());
+  for (alloc_const* alloc : mod_.allocs())
+    global_ids_.emplace(alloc, global_ids_.size());
+  // function table and bodies
+  put_varint(functions, mod_.get_function_list().size());
+  for (function* fn : mod_.get_function_list()) {
+    std::string body;
+    write_body(body, fn);
+    put_string(functions, fn->get_name());
+    put_varint(functions, get_type_id(fn->get_fn_type()));
+    for (argument* arg : fn->args())
+      put_string(functions, arg->get_name());
+    size_t num_attrs = 0;
+    for (const auto& x : fn->attrs())
+      num_attrs += x.second.size();
+    put_varint(functions, num_attrs);
+    for (const auto& x : fn->attrs())
+      for (const attribute& attr : x.second) {
+        put_varint(functions, x.first);
+        put_varint(functions, attr.get_kind());
+        put_varint(functions, attr.get_value());
+      }
+    put_varint(functions, bodies.size());
+    put_varint(functions, body.size());
+    bodies.append(body);
+  }
+  // module-level values never have local operands
+  local_ids_.clear();
+  current_ = 0;
+  put_varint(allocs, mod_.allocs().size());
+  for (alloc_const* alloc : mod_.allocs()) {
+    type* ty = alloc->get_type()->get_pointer_element_ty();
+    put_string(allocs, alloc->get_name());
+    put_varint(allocs, get_type_id(ty));
+    write_ref(allocs, alloc->get_operand(0));
+  }
+  put_varint(globals, mod_.globals().size());
+  for (const auto& x : mod_.globals()) {
+    put_string(globals, x.first);
+    write_ref(globals, x.second);
+  }
+  put_varint(metadatas, mod_.get_metadatas().size());
+  for (const auto& x : mod_.get_metadatas()) {
+    put_string(metadatas, x.first);
+    put_varint(metadatas, x.second.first);
+    put_varint(metadatas, x.second.second);
+  }
+  // header
+  header.append(bytecode_magic, sizeof(bytecode_magic));
+  put_u64(header, bytecode_version);
+  put_string(header, mod_.get_name());
+  put_varint(header, num_types_);
+  os << header << types_ << functions << allocs << globals << metadatas
+     << bodies;
+}
+
+//===----------------------------------------------------------------------===//
+//                               decoding
+//===----------------------------------------------------------------------===//
+
+// placeholder for a value used before it is decoded
+class forward_ref : public value {
+ public:
+  explicit forward_ref(type* ty) : value(ty) {}
+  void accept(visitor*) {}
+};
+
+class stream {
+ public:
+  stream(const char* begin, const char* end) : cur_(begin), end_(end) {}
+
+  void check(size_t size) {
+    if (size > size_t(end_ - cur_))
+      throw std::runtime_error("bytecode: unexpected end of data");
+  }
+
+  uint64_t get_varint() {
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      check(1);
+      uint8_t byte = *cur_++;
+      result |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return result;
+    }
+    throw std::runtime_error("bytecode: malformed integer");
+  }
+
+  unsigned get_unsigned() {
+    uint64_t result = get_varint();
+    if (result > 0xffffffff)
+      throw std::runtime_error("bytecode: integer out of range");
+    return result;
+  }
+
+  uint64_t get_u64() {
+    check(8);
+    uint64_t result = 0;
+    for (unsigned i = 0; i < 8; i++)
+      result |= uint64_t(uint8_t(*cur_++)) << (8 * i);
+    return result;
+  }
+
+  std::string get_string() {
+    uint64_t size = get_varint();
+    check(size);
+    std::string result(cur_, size);
+    cur_ += size;
+    return result;
+  }
+
+  void get_bytes(char* dst, size_t size) {
+    check(size);
+    std::memcpy(dst, cur_, size);
+    cur_ += size;
+  }
+
+  const char* position() const { return cur_; }
+
+ private:
+  const char* cur_;
+  const char* end_;
+};
+
+class decoder {
+ public:
+  decoder(stream& is, context& ctx, const std::vector<type*>& types,
+          const std::vector<value*>& globals)
+      : is_(is), ctx_(ctx), types_(types), globals_(globals) {}
+  type* read_type();
+  type* get_type();
+  value* get_ref();
+  void read_body(function* fn);
+
+ private:
+  value* get_local(bool range_sta);
+  basic_block* get_block();
+  instruction* read_instruction();
+  void define(instruction* inst);
+
+ private:
+  stream& is_;
+  context& ctx_;
+  const std::vector<type*>& types_;
+  const std::vector<value*>& globals_;
+  std::vector<value*> locals_;
+  // placeholders of values, and of the static ranges of values, that are
+  // used before they are decoded
+  std::map<unsigned, value*> forward_;
+  std::map<unsigned, value*> forward_sta_;
+};
+
+type* decoder::get_type() {
+  unsigned id = is_.get_unsigned();
+  if (id >= types_.size())
+    throw std::runtime_error("bytecode: invalid type reference");
+  return types_[id];
+}
+
+type* decoder::read_type() {
+  switch (is_.get_unsigned()) {
+    case type::VoidTyID:
+      return type::get_void_ty(ctx_);
+    case type::HalfTyID:
+      return type::get_half_ty(ctx_);
+    case type::FloatTyID:
+      return type::get_float_ty(ctx_);
+    case type::DoubleTyID:
+      return type::get_double_ty(ctx_);
+    case type::LabelTyID:
+      return type::get_label_ty(ctx_);
+    case type::IntegerTyID:
+      switch (is_.get_unsigned()) {
+        case 1:
+          return type::get_int1_ty(ctx_);
+        case 8:
+          return type::get_int8_ty(ctx_);
+        case 16:
+          return type::get_int16_ty(ctx_);
+        case 32:
+          return type::get_int32_ty(ctx_);
+        case 64:
+          return type::get_int64_ty(ctx_);
+        case 128:
+          return type::get_int128_ty(ctx_);
+        default:
+          throw std::runtime_error("bytecode: unsupported integer width");
+      }
+    case type::PointerTyID: {
+      type* elt_ty = get_type();
+      return pointer_type::get(elt_ty, is_.get_unsigned());
+    }
+    case type::TileTyID: {
+      type* elt_ty = get_type();
+      type::tile_shapes_t shapes(is_.get_unsigned());
+      for (unsigned& shape : shapes)
+        shape = is_.get_unsigned();
+      return tile_type::get(elt_ty, shapes);
+    }
+    case type::FunctionTyID: {
+      type* ret_ty = get_type();
+      std::vector<type*> param_tys(is_.get_unsigned());
+      for (type*& param_ty : param_tys)
+        param_ty = get_type();
+      return function_type::get(ret_ty, param_tys);
+    }
+    default:
+      throw std::runtime_error("bytecode: invalid type");
+  }
+}
+
+value* decoder::get_local(bool range_sta) {
+  unsigned id = is_.get_unsigned();
+  if (id < locals_.size()) {
+    if (!range_sta)
+      return locals_[id];
+    auto* range = dynamic_cast<make_range*>(locals_[id]);
+    if (!range)
+      throw std::runtime_error("bytecode: static range of a non-range");
+    return make_range_sta::get(range);
+  }
+  type* ty = get_type();
+  value*& result = (range_sta ? forward_sta_ : forward_)[id];
+  if (!result)
+    result = new (ctx_) forward_ref(ty);
+  return result;
+}
+
+basic_block* decoder::get_block() {
+  auto* result = dynamic_cast<basic_block*>(get_local(false));
+  if (!result)
+    throw std::runtime_error("bytecode: expected a basic block");
+  return result;
+}
+
+value* decoder::get_ref() {
+  switch (is_.get_unsigned()) {
+    case REF_LOCAL:
+      return get_local(false);
+    case REF_GLOBAL: {
+      unsigned id = is_.get_unsigned();
+      if (id >= globals_.size())
+        throw std::runtime_error("bytecode: invalid global reference");
+      return globals_[id];
+    }
+    case REF_INT: {
+      type* ty = get_type();
+      return constant_int::get(ty, is_.get_varint());
+    }
+    case REF_FP: {
+      type* ty = get_type();
+      uint64_t bits = is_.get_u64();
+      double value;
+      std::memcpy(&value, &bits, sizeof(value));
+      return constant_fp::get(ty, value);
+    }
+    case REF_UNDEF:
+      return undef_value::get(get_type());
+    case REF_RANGE_STA:
+      return get_local(true);
+    default:
+      throw std::runtime_error("bytecode: invalid operand kind");
+  }
+}
+
+instruction* decoder::read_instruction() {
+  unsigned id = is_.get_unsigned();
+  type* ty = get_type();
+  std::string name = is_.get_string();
+  std::vector<value*> ops(is_.get_unsigned());
+  for (value*& op : ops)
+    op = get_ref();
+  auto op = [&](unsigned i) {
+    if (i >= ops.size())
+      throw std::runtime_error("bytecode: missing operand");
+    return ops[i];
+  };
+  instruction* result = nullptr;
+  switch (id) {
+    case INST_PHI: {
+      phi_node* phi = phi_node::create(ty, ops.size(), name);
+      for (value* x : ops)
+        phi->add_incoming(x, get_block());
+      result = phi;
+      break;
+    }
+    case INST_BINOP: {
+      binary_op_t binop = (binary_op_t)is_.get_unsigned();
+      unsigned flags = is_.get_unsigned();
+      binary_operator* x = binary_operator::create(binop, op(0), op(1), name);
+      x->set_has_no_unsigned_wrap(flags & 1);
+      x->set_has_no_signed_wrap(flags & 2);
+      result = x;
+      break;
+    }
+    case INST_GETELEMENTPTR:
+      result = getelementptr_inst::create(
+          op(0), std::vector<value*>(ops.begin() + 1, ops.end()), name);
+      break;
+    case INST_SELECT:
+      result = select_inst::create(op(0), op(1), op(2), name);
+      break;
+    case INST_SQRT:
+      result = sqrt_inst::create(op(0), name);
+      break;
+    case INST_ICMP:
+      result = icmp_inst::create((cmp_pred_t)is_.get_unsigned(), op(0), op(1),
+                                 name);
+      break;
+    case INST_FCMP:
+      result = fcmp_inst::create((cmp_pred_t)is_.get_unsigned(), op(0), op(1),
+                                 name);
+      break;
+    case INST_CAST_TRUNC:
+    case INST_CAST_ZEXT:
+    case INST_CAST_SEXT:
+    case INST_CAST_FP_TRUNC:
+    case INST_CAST_FP_EXT:
+    case INST_CAST_UI_TO_FP:
+    case INST_CAST_SI_TO_FP:
+    case INST_CAST_FP_TO_UI:
+    case INST_CAST_FP_TO_SI:
+    case INST_CAST_PTR_TO_INT:
+    case INST_CAST_INT_TO_PTR:
+    case INST_CAST_BIT_CAST:
+    case INST_CAST_ADDR_SPACE_CAST:
+      result = cast_inst::create((cast_op_t)is_.get_unsigned(), op(0), ty,
+                                 name);
+      break;
+    case INST_RETURN:
+      result = return_inst::create(ctx_, ops.empty() ? nullptr : op(0));
+      break;
+    case INST_COND_BRANCH: {
+      auto* if_dst = dynamic_cast<basic_block*>(op(0));
+      auto* else_dst = dynamic_cast<basic_block*>(op(1));
+      if (!if_dst || !else_dst)
+        throw std::runtime_error("bytecode: expected a basic block");
+      result = branch_inst::create(op(2), if_dst, else_dst);
+      break;
+    }
+    case INST_UNCOND_BRANCH: {
+      auto* dst = dynamic_cast<basic_block*>(op(0));
+      if (!dst)
+        throw std::runtime_error("bytecode: expected a basic block");
+      result = branch_inst::create(dst);
+      break;
+    }
+    case INST_UNMASKED_LOAD:
+      result = unmasked_load_inst::create(op(0), name);
+      break;
+    case INST_MASKED_LOAD:
+      result = masked_load_inst::create(op(0), op(1), op(2), name);
+      break;
+    case INST_UNMASKED_STORE:
+      result = unmasked_store_inst::create(op(0), op(1), name);
+      break;
+    case INST_MASKED_STORE:
+      result = masked_store_inst::create(op(0), op(1), op(2), name);
+      break;
+    case INST_RESHAPE:
+      result = reshape_inst::create(op(0), ty->get_tile_shapes(), name);
+      break;
+    case INST_SPLAT:
+      result = splat_inst::create(op(0), ty->get_tile_shapes(), name);
+      break;
+    case INST_BROADCAST:
+      result = broadcast_inst::create(op(0), ty->get_tile_shapes(), name);
+      break;
+    case INST_DOWNCAST:
+      result = downcast_inst::create(op(0), name);
+      break;
+    case INST_GET_PROGRAM_ID:
+      result = get_program_id_inst::create(ty, is_.get_unsigned(), name);
+      break;
+    case INST_GET_NUM_PROGRAMS:
+      result = get_num_program_inst::create(ty, is_.get_unsigned(), name);
+      break;
+    case INST_ATOMIC_CAS:
+      result = atomic_cas_inst::create(op(0), op(1), op(2), name);
+      break;
+    case INST_ATOMIC_EXCH:
+      result = atomic_exch_inst::create(op(0), op(1), name);
+      break;
+    case INST_ATOMIC_ADD:
+      result = atomic_add_inst::create(op(0), op(1), name);
+      break;
+    case INST_TRANS: {
+      std::vector<int> perm(is_.get_unsigned());
+      for (int& x : perm)
+        x = is_.get_unsigned();
+      result = trans_inst::create(op(0), perm, name);
+      break;
+    }
+    case INST_REDUCE: {
+      reduce_inst::op_t reduce_op = (reduce_inst::op_t)is_.get_unsigned();
+      result = reduce_inst::create(op(0), reduce_op, is_.get_unsigned(), name);
+      break;
+    }
+    case INST_DOT:
+      result = dot_inst::create_nn(op(0), op(1), op(2), name);
+      break;
+    case INST_COPY_TO_SHARED:
+      result = copy_to_shared_inst::create(op(0), name);
+      break;
+    case INST_COPY_FROM_SHARED:
+      result = copy_from_shared_inst::create(op(0), name);
+      break;
+    case INST_RECOALESCE:
+      result = recoalesce_inst::create(op(0), name);
+      break;
+    case INST_BARRIER:
+      result = barrier_inst::create(ctx_, name);
+      break;
+    case INST_MAKE_RANGE_DYN:
+      result = make_range_dyn::create(ty, name);
+      break;
+    case INST_MAKE_RANGE: {
+      auto* first = dynamic_cast<constant_int*>(get_ref());
+      auto* last = dynamic_cast<constant_int*>(get_ref());
+      if (!first || !last)
+        throw std::runtime_error("bytecode: invalid range bounds");
+      result = make_range::create(first, last);
+      break;
+    }
+    default:
+      throw std::runtime_error("bytecode: invalid instruction id " +
+                               std::to_string(id));
+  }
+  if (result->get_type() != ty)
+    throw std::runtime_error("bytecode: type mismatch in " + result->repr());
+  result->set_name(name);
+  // metadata
+  unsigned num_metadatas = is_.get_unsigned();
+  for (unsigned i = 0; i < num_metadatas; i++) {
+    metadata::kind_t kind = (metadata::kind_t)is_.get_unsigned();
+    result->set_metadata(kind, is_.get_unsigned());
+  }
+  return result;
+}
+
+void decoder::define(instruction* inst) {
+  unsigned id = locals_.size();
+  locals_.push_back(inst);
+  auto it = forward_.find(id);
+  if (it != forward_.end()) {
+    it->second->replace_all_uses_with(inst);
+    forward_.erase(it);
+  }
+  it = forward_sta_.find(id);
+  if (it != forward_sta_.end()) {
+    auto* range = dynamic_cast<make_range*>(inst);
+    if (!range)
+      throw std::runtime_error("bytecode: static range of a non-range");
+    it->second->replace_all_uses_with(make_range_sta::get(range));
+    forward_sta_.erase(it);
+  }
+}
+
+void decoder::read_body(function* fn) {
+  locals_.assign(fn->args().begin(), fn->args().end());
+  // blocks
+  std::vector<basic_block*> blocks(is_.get_unsigned());
+  for (basic_block*& block : blocks) {
+    block = basic_block::create(ctx_, is_.get_string(), fn);
+    locals_.push_back(block);
+  }
+  for (basic_block* block : blocks) {
+    unsigned num_preds = is_.get_unsigned();
+    for (unsigned i = 0; i < num_preds; i++)
+      block->add_predecessor(get_block());
+  }
+  // instructions
+  for (basic_block* block : blocks) {
+    unsigned num_insts = is_.get_unsigned();
+    for (unsigned i = 0; i < num_insts; i++) {
+      instruction* inst = read_instruction();
+      block->get_inst_list().push_back(inst);
+      define(inst);
+    }
+  }
+  if (!forward_.empty() || !forward_sta_.empty())
+    throw std::runtime_error("bytecode: reference to an undefined value in " +
+                             fn->get_name());
+}
+
+}  // namespace
+
+//===----------------------------------------------------------------------===//
+//                               writer
+//===----------------------------------------------------------------------===//
+
+void write_bytecode(module& mod, std::ostream& os) { writer(mod).write(os); }
+
+//===----------------------------------------------------------------------===//
+//                               reader
+//===----------------------------------------------------------------------===//
+
+bytecode_reader::bytecode_reader(const char* data, size_t size, void* mapping)
+    : data_(data), size_(size), mapping_(mapping) {}
+
+bytecode_reader::~bytecode_reader() {
+  if (mapping_)
+    munmap(mapping_, size_);
+}
+
+std::unique_ptr<bytecode_reader> bytecode_reader::create(const char* data,
+                                                         size_t size) {
+  return std::unique_ptr<bytecode_reader>(
+      new bytecode_reader(data, size, nullptr));
+}
+
+std::unique_ptr<bytecode_reader> bytecode_reader::open(
+    const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("bytecode: cannot open " + path);
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    close(fd);
+    throw std::runtime_error("bytecode: cannot read " + path);
+  }
+  void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    throw std::runtime_error("bytecode: cannot map " + path);
+  return std::unique_ptr<bytecode_reader>(
+      new bytecode_reader((const char*)mapping, st.st_size, mapping));
+}
+
+std::unique_ptr<module> bytecode_reader::parse_module(context& ctx) {
+  stream is(data_, data_ + size_);
+  decoder dec(is, ctx, types_, globals_);
+  // header
+  char magic[sizeof(bytecode_magic)];
+  is.get_bytes(magic, sizeof(magic));
+  if (std::memcmp(magic, bytecode_magic, sizeof(magic)))
+    throw std::runtime_error("bytecode: invalid magic number");
+  uint64_t version = is.get_u64();
+  if (version != bytecode_version)
+    throw std::runtime_error("bytecode: unsupported version " +
+                             std::to_string(version));
+  std::unique_ptr<module> result(new module(is.get_string(), ctx));
+  // types; entries only refer to previous ones
+  unsigned num_types = is.get_unsigned();
+  types_.clear();
+  for (unsigned i = 0; i < num_types; i++)
+    types_.push_back(dec.read_type());
+  // function table
+  functions_.resize(is.get_unsigned());
+  for (size_t i = 0; i < functions_.size(); i++) {
+    function_entry& entry = functions_[i];
+    std::string name = is.get_string();
+    auto* fn_ty = dynamic_cast<function_type*>(dec.get_type());
+    if (!fn_ty)
+      throw std::runtime_error("bytecode: " + name + " is not a function");
+    entry.fn = result->get_or_insert_function(name, fn_ty);
+    for (argument* arg : entry.fn->args())
+      arg->set_name(is.get_string());
+    unsigned num_attrs = is.get_unsigned();
+    for (unsigned i = 0; i < num_attrs; i++) {
+      unsigned arg_id = is.get_unsigned();
+      attribute_kind_t kind = (attribute_kind_t)is.get_unsigned();
+      entry.fn->add_attr(arg_id, attribute(kind, is.get_unsigned()));
+    }
+    entry.offset = is.get_varint();
+    entry.size = is.get_varint();
+    entry.materialized = false;
+    function_ids_[entry.fn] = i;
+    globals_.push_back(entry.fn);
+  }
+  // allocs
+  unsigned num_allocs = is.get_unsigned();
+  for (unsigned i = 0; i < num_allocs; i++) {
+    std::string name = is.get_string();
+    type* ty = dec.get_type();
+    auto* size = dynamic_cast<constant_int*>(dec.get_ref());
+    if (!size)
+      throw std::runtime_error("bytecode: invalid size of " + name);
+    alloc_const* alloc = new (ctx) alloc_const(ty, size, name);
+    result->add_alloc(alloc);
+    globals_.push_back(alloc);
+  }
+  // globals
+  unsigned num_globals = is.get_unsigned();
+  for (unsigned i = 0; i < num_globals; i++) {
+    std::string name = is.get_string();
+    result->register_global(name, dec.get_ref());
+  }
+  // metadata
+  unsigned num_metadatas = is.get_unsigned();
+  for (unsigned i = 0; i < num_metadatas; i++) {
+    std::string name = is.get_string();
+    metadata::kind_t kind = (metadata::kind_t)is.get_unsigned();
+    result->add_metadata(name, {kind, is.get_unsigned()});
+  }
+  // bodies are addressed relative to the end of the tables
+  size_t bodies = is.position() - data_;
+  for (function_entry& entry : functions_) {
+    if (entry.offset > size_ - bodies ||
+        entry.size > size_ - bodies - entry.offset)
+      throw std::runtime_error("bytecode: invalid body of " +
+                               entry.fn->get_name());
+    entry.offset += bodies;
+  }
+  return result;
+}
+
+bool bytecode_reader::is_materialized(function* fn) const {
+  auto it = function_ids_.find(fn);
+  return it == function_ids_.end() || functions_[it->second].materialized;
+}
+
+void bytecode_reader::materialize(function_entry& entry) {
+  if (entry.materialized)
+    return;
+  stream is(data_ + entry.offset, data_ + entry.offset + entry.size);
+  decoder dec(is, entry.fn->get_type()->get_context(), types_, globals_);
+  dec.read_body(entry.fn);
+  entry.materialized = true;
+}
+
+void bytecode_reader::materialize(function* fn) {
+  auto it = function_ids_.find(fn);
+  if (it == function_ids_.end())
+    throw std::runtime_error("bytecode: unknown function " + fn->get_name());
+  materialize(functions_[it->second]);
+}
+
+void bytecode_reader::materialize_all() {
+  for (function_entry& entry : functions_)
+    materialize(entry);
+}
+
+}  // namespace ir
+}  // namespace tensorscript
@@ -1,6 +1,7 @@
 #include "tensorscript/ir/constant.h"
 
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 #include "tensorscript/ir/context.h"
@@ -45,11 +46,13 @@ constant_int::constant_int(type* ty, uint64_t value)
     : constant(ty, 0), value_(value) {}
 
 constant_int* constant_int::get(type* ty, uint64_t value) {
-  context_impl* impl = ty->get_context().p_impl.get();
-  constant_int*& cst = impl->int_constants_[std::make_pair(ty, value)];
-  if (cst == nullptr)
-    cst = new constant_int(ty, value);
-  return cst;
+  context& ctx = ty->get_context();
+  return ctx.p_impl->int_constants_.get_or_create(
+      std::make_pair(ty, value), [&] {
+        constant_int* result = new (ctx) constant_int(ty, value);
+        result->set_shared();
+        return result;
+      });
 }
 
 // constant_fp
@@ -70,22 +73,27 @@ constant* constant_fp::get_zero_value_for_negation(type* ty) {
 }
 
 constant* constant_fp::get(type* ty, double v) {
-  context_impl* impl = ty->get_context().p_impl.get();
-  constant_fp*& result = impl->fp_constants_[std::make_pair(ty, v)];
-  if (!result)
-    result = new constant_fp(ty, v);
-  return result;
+  context& ctx = ty->get_context();
+  uint64_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return ctx.p_impl->fp_constants_.get_or_create(
+      std::make_pair(ty, bits), [&] {
+        constant_fp* result = new (ctx) constant_fp(ty, v);
+        result->set_shared();
+        return result;
+      });
 }
 
 // undef value
 undef_value::undef_value(type* ty) : constant(ty, 0) {}
 
 undef_value* undef_value::get(type* ty) {
-  context_impl* impl = ty->get_context().p_impl.get();
-  undef_value*& result = impl->uv_constants_[ty];
-  if (!result)
-    result = new undef_value(ty);
-  return result;
+  context& ctx = ty->get_context();
+  return ctx.p_impl->uv_constants_.get_or_create(ty, [&] {
+    undef_value* result = new (ctx) undef_value(ty);
+    result->set_shared();
+    return result;
+  });
 }
 
 /* global value */
@@ -1,5 +1,8 @@
 #include "tensorscript/ir/context.h"
 
+#include <atomic>
+#include <mutex>
+
 #include "tensorscript/ir/context_impl.h"
 #include "tensorscript/ir/type.h"
 
@@ -10,8 +13,17 @@ namespace ir {
 //                               context implementation
 //===----------------------------------------------------------------------===//
 
-context_impl::context_impl(context& ctx)
-    : void_ty(ctx, type::VoidTyID),
+// contexts are numbered so that chunks of a destroyed context are never
+// reused by a context allocated at the same address
+static std::atomic<uint64_t> num_contexts(0);
+
+// size of the chunks of the arena owned by threads
+static const size_t local_chunk_size = 8 * 1024;
+
+context_impl::context_impl(context& ctx, bool thread_safe)
+    : thread_safe(thread_safe),
+      id(++num_contexts),
+      void_ty(ctx, type::VoidTyID),
       label_ty(ctx, type::LabelTyID),
       half_ty(ctx, type::HalfTyID),
       float_ty(ctx, type::FloatTyID),
@@ -21,13 +33,67 @@ context_impl::context_impl(context& ctx)
       int16_ty(ctx, 16),
       int32_ty(ctx, 32),
       int64_ty(ctx, 64),
-      int128_ty(ctx, 128) {}
+      int128_ty(ctx, 128),
+      ptr_tys(thread_safe),
+      tile_tys(thread_safe),
+      int_constants_(thread_safe),
+      fp_constants_(thread_safe),
+      uv_constants_(thread_safe),
+      range_constants_(thread_safe) {}
+
+void* context_impl::allocate(size_t size, size_t align,
+                             void (*finalizer)(void*)) {
+  if (!thread_safe) {
+    void* ptr = arena.allocate(size, align);
+    if (finalizer)
+      arena.on_destroy(ptr, finalizer);
+    return ptr;
+  }
+  void* ptr = allocate_local(size, align);
+  if (finalizer)
+    arena.on_destroy(
+        allocate_local(tools::arena::finalizer_size,
+                       tools::arena::finalizer_align),
+        ptr, finalizer);
+  return ptr;
+}
+
+// bump allocation from a chunk of the arena owned by the calling thread
+void* context_impl::allocate_local(size_t size, size_t align) {
+  struct chunk_t {
+    uint64_t owner;
+    char* cur;
+    char* end;
+  };
+  static thread_local chunk_t chunk = {0, nullptr, nullptr};
+  if (size + align > local_chunk_size / 4) {
+    std::lock_guard<std::mutex> lock(arena_mutex);
+    return arena.allocate(size, align);
+  }
+  char* result =
+      chunk.owner == id ? tools::arena::align_up(chunk.cur, align) : nullptr;
+  if (!result || result + size > chunk.end) {
+    {
+      std::lock_guard<std::mutex> lock(arena_mutex);
+      chunk.cur = static_cast<char*>(arena.allocate(local_chunk_size));
+    }
+    chunk.end = chunk.cur + local_chunk_size;
+    chunk.owner = id;
+    result = tools::arena::align_up(chunk.cur, align);
+  }
+  chunk.cur = result + size;
+  return result;
+}
+
+// finalizers are cancelled without unlinking them, so no lock is needed
+void context_impl::cancel(void* ptr) { arena.cancel(ptr); }
 
 //===----------------------------------------------------------------------===//
 //                                    context
 //===----------------------------------------------------------------------===//
 
-context::context() : p_impl(std::make_shared<context_impl>(*this)) {}
+context::context(bool thread_safe)
+    : p_impl(std::make_shared<context_impl>(*this, thread_safe)) {}
 
 }  // namespace ir
 }  // namespace tensorscript
\ No newline at end of file
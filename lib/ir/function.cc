@@ -16,7 +16,7 @@ argument::argument(type* ty, const std::string& name, function* parent,
 
 argument* argument::create(type* ty, const std::string& name, function* parent,
                            unsigned arg_no) {
-  return new argument(ty, name, parent, arg_no);
+  return new (ty->get_context()) argument(ty, name, parent, arg_no);
 }
 
 function* argument::get_parent() const { return parent_; }
@@ -30,9 +30,6 @@ function::function(function_type* ty, linkage_types_t linkage,
                    const std::string& name, module* parent)
     : global_object(ty, 0, linkage, name), parent_(parent), fn_ty_(ty) {
   unsigned num_params = fn_ty_->get_num_params();
-  // skip if no parameter
-  if (num_params == 0)
-    return;
   // create arguments
   args_.resize(num_params);
   for (unsigned i = 0; i < num_params; i++) {
@@ -49,9 +46,15 @@ void function::insert_block(basic_block* block, basic_block* next) {
   blocks_.insert(it, block);
 }
 
+void function::erase_block(basic_block* block) {
+  auto it = std::find(blocks_.begin(), blocks_.end(), block);
+  if (it != blocks_.end())
+    blocks_.erase(it);
+}
+
 function* function::create(function_type* ty, linkage_types_t linkage,
                            const std::string& name, module* mod) {
-  return new function(ty, linkage, name, mod);
+  return new (ty->get_context()) function(ty, linkage, name, mod);
 }
 
 }  // namespace ir
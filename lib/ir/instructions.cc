@@ -6,6 +6,7 @@
 #include "tensorscript/ir/basic_block.h"
 #include "tensorscript/ir/constant.h"
 #include "tensorscript/ir/context.h"
+#include "tensorscript/ir/context_impl.h"
 #include "tensorscript/ir/type.h"
 
 namespace tensorscript {
@@ -17,19 +18,28 @@ namespace ir {
 
 instruction::instruction(type* ty, value_id_t ity, unsigned num_ops,
                          const std::string& name, instruction* next)
-    : user(ty, num_ops, name), id_(ity) {
+    : user(ty, num_ops, name),
+      parent_(nullptr),
+      prev_(nullptr),
+      next_(nullptr),
+      order_(0),
+      id_(ity) {
   if (next) {
     basic_block* block = next->get_parent();
     assert(block && "Next instruction is not in a basic block!");
-    auto it = std::find(block->begin(), block->end(), next);
-    block->get_inst_list().insert(it, next);
+    block->get_inst_list().insert(block->iterator_to(next), this);
   }
 }
 
 void instruction::erase_from_parent() {
   parent_->erase(this);
-  for (ir::value* op : ops())
-    op->erase_use(this);
+  drop_all_references();
+}
+
+bool instruction::comes_before(const instruction* other) const {
+  assert(parent_ && parent_ == other->parent_ &&
+         "instructions are not in the same block");
+  return parent_->get_inst_list().comes_before(this, other);
 }
 
 bool instruction::has_tile_result_or_op() {
@@ -71,10 +81,22 @@ void phi_node::add_incoming(value* v, basic_block* block) {
   set_incoming_block(get_num_operands() - 1, block);
 }
 
+// Remove incoming
+void phi_node::remove_incoming(unsigned i) {
+  unsigned n = get_num_operands();
+  assert(i < n && "remove_incoming() out of range!");
+  for (unsigned k = i; k + 1 < n; k++) {
+    set_operand(k, get_operand(k + 1));
+    blocks_[k] = blocks_[k + 1];
+  }
+  resize_ops(n - 1);
+  blocks_.resize(n - 1);
+}
+
 // Factory methods
 phi_node* phi_node::create(type* ty, unsigned num_reserved,
                            const std::string& name, instruction* next) {
-  return new phi_node(ty, num_reserved, name, next);
+  return new (ty->get_context()) phi_node(ty, num_reserved, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -147,7 +169,10 @@ bool binary_operator::is_int_add_sub() const {
 binary_operator::binary_operator(binary_op_t op, value* lhs, value* rhs,
                                  type* ty, const std::string& name,
                                  instruction* next)
-    : instruction(ty, INST_BINOP, 2, name, next), op_(op) {
+    : instruction(ty, INST_BINOP, 2, name, next),
+      op_(op),
+      has_no_unsigned_wrap_(false),
+      has_no_signed_wrap_(false) {
   set_operand(0, lhs);
   set_operand(1, rhs);
 }
@@ -157,7 +182,8 @@ binary_operator* binary_operator::create(binary_op_t op, value* lhs, value* rhs,
                                          instruction* next) {
   assert(lhs->get_type() == rhs->get_type() &&
          "Cannot create binary operator with two operands of differing type!");
-  return new binary_operator(op, lhs, rhs, lhs->get_type(), name, next);
+  type* ty = lhs->get_type();
+  return new (ty->get_context()) binary_operator(op, lhs, rhs, ty, name, next);
 }
 
 // binary_operator *binary_operator::create_fneg(value *arg, const std::string
@@ -277,7 +303,8 @@ icmp_inst* icmp_inst::create(cmp_pred_t pred, value* lhs, value* rhs,
                              const std::string& name, instruction* next) {
   assert(is_int_predicate(pred));
   type* res_ty = make_cmp_result_type(lhs->get_type());
-  return new icmp_inst(res_ty, pred, lhs, rhs, name, next);
+  context& ctx = res_ty->get_context();
+  return new (ctx) icmp_inst(res_ty, pred, lhs, rhs, name, next);
 }
 
 // fcmp_inst
@@ -289,7 +316,8 @@ fcmp_inst* fcmp_inst::create(cmp_pred_t pred, value* lhs, value* rhs,
                              const std::string& name, instruction* next) {
   assert(is_fp_predicate(pred));
   type* res_ty = make_cmp_result_type(lhs->get_type());
-  return new fcmp_inst(res_ty, pred, lhs, rhs, name, next);
+  context& ctx = res_ty->get_context();
+  return new (ctx) fcmp_inst(res_ty, pred, lhs, rhs, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -347,34 +375,35 @@ bool cast_inst::is_valid(cast_op_t op, value* arg, type* ty) {
 cast_inst* cast_inst::create(cast_op_t op, value* arg, type* ty,
                              const std::string& name, instruction* next) {
   assert(is_valid(op, arg, ty) && "Invalid cast!");
+  context& ctx = ty->get_context();
   // Construct and return the appropriate CastInst subclass
   switch (op) {
     case cast_op_t::Trunc:
-      return new trunc_inst(ty, arg, name, next);
+      return new (ctx) trunc_inst(ty, arg, name, next);
     case cast_op_t::ZExt:
-      return new z_ext_inst(ty, arg, name, next);
+      return new (ctx) z_ext_inst(ty, arg, name, next);
     case cast_op_t::SExt:
-      return new s_ext_inst(ty, arg, name, next);
+      return new (ctx) s_ext_inst(ty, arg, name, next);
     case cast_op_t::FPTrunc:
-      return new fp_trunc_inst(ty, arg, name, next);
+      return new (ctx) fp_trunc_inst(ty, arg, name, next);
     case cast_op_t::FPExt:
-      return new fp_ext_inst(ty, arg, name, next);
+      return new (ctx) fp_ext_inst(ty, arg, name, next);
     case cast_op_t::UIToFP:
-      return new ui_to_fp_inst(ty, arg, name, next);
+      return new (ctx) ui_to_fp_inst(ty, arg, name, next);
     case cast_op_t::SIToFP:
-      return new si_to_fp_inst(ty, arg, name, next);
+      return new (ctx) si_to_fp_inst(ty, arg, name, next);
     case cast_op_t::FPToUI:
-      return new fp_to_ui_inst(ty, arg, name, next);
+      return new (ctx) fp_to_ui_inst(ty, arg, name, next);
     case cast_op_t::FPToSI:
-      return new fp_to_si_inst(ty, arg, name, next);
+      return new (ctx) fp_to_si_inst(ty, arg, name, next);
     case cast_op_t::PtrToInt:
-      return new ptr_to_int_inst(ty, arg, name, next);
+      return new (ctx) ptr_to_int_inst(ty, arg, name, next);
     case cast_op_t::IntToPtr:
-      return new int_to_ptr_inst(ty, arg, name, next);
+      return new (ctx) int_to_ptr_inst(ty, arg, name, next);
     case cast_op_t::BitCast:
-      return new bit_cast_inst(ty, arg, name, next);
+      return new (ctx) bit_cast_inst(ty, arg, name, next);
     case cast_op_t::AddrSpaceCast:
-      return new addr_space_cast_inst(ty, arg, name, next);
+      return new (ctx) addr_space_cast_inst(ty, arg, name, next);
     default:
       throw std::runtime_error("unreachable");
   }
@@ -410,20 +439,21 @@ return_inst::return_inst(context& ctx, value* ret_val, instruction* next)
 
 return_inst* return_inst::create(context& ctx, value* ret_val,
                                  instruction* next) {
-  return new return_inst(ctx, ret_val, next);
+  return new (ctx) return_inst(ctx, ret_val, next);
 }
 
 // branch_inst
 branch_inst* branch_inst::create(basic_block* dst, instruction* next) {
   assert(dst && "Branch destination may not be null!");
-  return new uncond_branch_inst(dst, next);
+  return new (dst->get_context()) uncond_branch_inst(dst, next);
 }
 
 branch_inst* branch_inst::create(value* cond, basic_block* if_dst,
                                  basic_block* else_dst, instruction* next) {
   assert(cond->get_type()->is_integer_ty(1) &&
          "May only branch on boolean predicates!");
-  return new cond_branch_inst(if_dst, else_dst, cond, next);
+  return new (if_dst->get_context())
+      cond_branch_inst(if_dst, else_dst, cond, next);
 }
 
 // uncond_branch_inst
@@ -516,7 +546,8 @@ getelementptr_inst* getelementptr_inst::create(value* ptr,
                                                instruction* next) {
   type* pointee_ty =
       ((pointer_type*)(ptr->get_type()->get_scalar_ty()))->get_element_ty();
-  return new getelementptr_inst(pointee_ty, ptr, idx, name, next);
+  context& ctx = pointee_ty->get_context();
+  return new (ctx) getelementptr_inst(pointee_ty, ptr, idx, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -552,7 +583,8 @@ unmasked_load_inst::unmasked_load_inst(value* ptr, const std::string& name,
 unmasked_load_inst* unmasked_load_inst::create(value* ptr,
                                                const std::string& name,
                                                instruction* next) {
-  return new unmasked_load_inst(ptr, name, next);
+  context& ctx = ptr->get_type()->get_context();
+  return new (ctx) unmasked_load_inst(ptr, name, next);
 }
 
 // masked load
@@ -568,7 +600,8 @@ masked_load_inst* masked_load_inst::create(value* ptr, value* mask,
                                            value* false_value,
                                            const std::string& name,
                                            instruction* next) {
-  return new masked_load_inst(ptr, mask, false_value, name, next);
+  context& ctx = ptr->get_type()->get_context();
+  return new (ctx) masked_load_inst(ptr, mask, false_value, name, next);
 }
 
 store_inst::store_inst(value* ptr, value_id_t id, unsigned num_ops,
@@ -588,7 +621,8 @@ unmasked_store_inst::unmasked_store_inst(value* ptr, value* val,
 unmasked_store_inst* unmasked_store_inst::create(value* ptr, value* val,
                                                  const std::string& name,
                                                  instruction* next) {
-  return new unmasked_store_inst(ptr, val, name, next);
+  context& ctx = ptr->get_type()->get_context();
+  return new (ctx) unmasked_store_inst(ptr, val, name, next);
 }
 
 // masked store
@@ -604,7 +638,8 @@ masked_store_inst* masked_store_inst::create(value* ptr, value* val,
                                              value* mask,
                                              const std::string& name,
                                              instruction* next) {
-  return new masked_store_inst(ptr, val, mask, name, next);
+  context& ctx = ptr->get_type()->get_context();
+  return new (ctx) masked_store_inst(ptr, val, mask, name, next);
 }
 //===----------------------------------------------------------------------===//
 //                               retile_inst classes
@@ -620,14 +655,16 @@ retile_inst::retile_inst(value* arg, value_id_t id,
 
 instruction* reshape_inst::create(value* arg, const type::tile_shapes_t& shapes,
                                   const std::string& name, instruction* next) {
-  return new reshape_inst(arg, INST_RESHAPE, shapes, name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) reshape_inst(arg, INST_RESHAPE, shapes, name, next);
 }
 
 // splat
 
 instruction* splat_inst::create(value* arg, const type::tile_shapes_t& shapes,
                                 const std::string& name, instruction* next) {
-  return new splat_inst(arg, INST_SPLAT, shapes, name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) splat_inst(arg, INST_SPLAT, shapes, name, next);
 }
 
 // broadcast
@@ -636,15 +673,17 @@ instruction* broadcast_inst::create(value* arg,
                                     const type::tile_shapes_t& shapes,
                                     const std::string& name,
                                     instruction* next) {
-  return new broadcast_inst(arg, INST_BROADCAST, shapes, name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) broadcast_inst(arg, INST_BROADCAST, shapes, name, next);
 }
 
 // downcast
 
 instruction* downcast_inst::create(value* arg, const std::string& name,
                                    instruction* next) {
-  return new downcast_inst(arg->get_type()->get_scalar_ty(), INST_DOWNCAST, arg,
-                           name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) downcast_inst(arg->get_type()->get_scalar_ty(),
+                                 INST_DOWNCAST, arg, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -663,27 +702,32 @@ instruction* dot_inst::create(value* A, value* B, value* C, bool AT, bool BT,
                               const std::string& name, instruction* next) {
   TransT OPA = AT ? Trans : NoTrans;
   TransT OPB = BT ? Trans : NoTrans;
-  return new dot_inst(A, B, C, OPA, OPB, name, next);
+  context& ctx = A->get_type()->get_context();
+  return new (ctx) dot_inst(A, B, C, OPA, OPB, name, next);
 }
 
 instruction* dot_inst::create_nn(value* A, value* B, value* C,
                                  const std::string& name, instruction* next) {
-  return new dot_inst(A, B, C, NoTrans, NoTrans, name, next);
+  context& ctx = A->get_type()->get_context();
+  return new (ctx) dot_inst(A, B, C, NoTrans, NoTrans, name, next);
 }
 
 instruction* dot_inst::create_nt(value* A, value* B, value* C,
                                  const std::string& name, instruction* next) {
-  return new dot_inst(A, B, C, NoTrans, Trans, name, next);
+  context& ctx = A->get_type()->get_context();
+  return new (ctx) dot_inst(A, B, C, NoTrans, Trans, name, next);
 }
 
 instruction* dot_inst::create_tn(value* A, value* B, value* C,
                                  const std::string& name, instruction* next) {
-  return new dot_inst(A, B, C, Trans, NoTrans, name, next);
+  context& ctx = A->get_type()->get_context();
+  return new (ctx) dot_inst(A, B, C, Trans, NoTrans, name, next);
 }
 
 instruction* dot_inst::create_tt(value* A, value* B, value* C,
                                  const std::string& name, instruction* next) {
-  return new dot_inst(A, B, C, Trans, Trans, name, next);
+  context& ctx = A->get_type()->get_context();
+  return new (ctx) dot_inst(A, B, C, Trans, Trans, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -727,7 +771,8 @@ trans_inst::trans_inst(value* arg, const std::vector<int>& perm,
 
 instruction* trans_inst::create(value* arg, const std::vector<int>& perm,
                                 const std::string& name, instruction* next) {
-  return new trans_inst(arg, perm, name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) trans_inst(arg, perm, name, next);
 }
 
 const std::vector<int> trans_inst::get_perm() const { return perm_; }
@@ -743,7 +788,8 @@ sqrt_inst::sqrt_inst(value* arg, const std::string& name, instruction* next)
 
 instruction* sqrt_inst::create(value* arg, const std::string& name,
                                instruction* next) {
-  return new sqrt_inst(arg, name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) sqrt_inst(arg, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -795,7 +841,8 @@ reduce_inst::reduce_inst(value* arg, op_t op, unsigned axis,
 
 instruction* reduce_inst::create(value* arg, op_t op, unsigned axis,
                                  const std::string& name, instruction* next) {
-  return new reduce_inst(arg, op, axis, name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) reduce_inst(arg, op, axis, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -813,7 +860,8 @@ select_inst::select_inst(value* pred, value* if_value, value* else_value,
 instruction* select_inst::create(value* pred, value* if_value,
                                  value* else_value, const std::string& name,
                                  instruction* next) {
-  return new select_inst(pred, if_value, else_value, name, next);
+  context& ctx = pred->get_type()->get_context();
+  return new (ctx) select_inst(pred, if_value, else_value, name, next);
 }
 //===----------------------------------------------------------------------===//
 //                               builtin instructions
@@ -828,7 +876,13 @@ get_program_id_inst::get_program_id_inst(type* ty, unsigned axis,
 instruction* get_program_id_inst::create(context& ctx, unsigned axis,
                                          const std::string& name,
                                          instruction* next) {
-  return new get_program_id_inst(type::get_int32_ty(ctx), axis, name, next);
+  return create(type::get_int32_ty(ctx), axis, name, next);
+}
+
+instruction* get_program_id_inst::create(type* ty, unsigned axis,
+                                         const std::string& name,
+                                         instruction* next) {
+  return new (ty->get_context()) get_program_id_inst(ty, axis, name, next);
 }
 
 // get_num_program
@@ -840,7 +894,13 @@ get_num_program_inst::get_num_program_inst(type* ty, unsigned axis,
 instruction* get_num_program_inst::create(context& ctx, unsigned axis,
                                           const std::string& name,
                                           instruction* next) {
-  return new get_num_program_inst(type::get_int32_ty(ctx), axis, name, next);
+  return create(type::get_int32_ty(ctx), axis, name, next);
+}
+
+instruction* get_num_program_inst::create(type* ty, unsigned axis,
+                                          const std::string& name,
+                                          instruction* next) {
+  return new (ty->get_context()) get_num_program_inst(ty, axis, name, next);
 }
 
 // atomic cas
@@ -857,7 +917,8 @@ atomic_cas_inst::atomic_cas_inst(value* ptr, value* cmp, value* val,
 instruction* atomic_cas_inst::create(value* ptr, value* cmp, value* val,
                                      const std::string& name,
                                      instruction* next) {
-  return new atomic_cas_inst(ptr, cmp, val, name, next);
+  context& ctx = ptr->get_type()->get_context();
+  return new (ctx) atomic_cas_inst(ptr, cmp, val, name, next);
 }
 
 // atomic exch
@@ -873,7 +934,8 @@ atomic_exch_inst::atomic_exch_inst(value* ptr, value* val,
 instruction* atomic_exch_inst::create(value* ptr, value* val,
                                       const std::string& name,
                                       instruction* next) {
-  return new atomic_exch_inst(ptr, val, name, next);
+  context& ctx = ptr->get_type()->get_context();
+  return new (ctx) atomic_exch_inst(ptr, val, name, next);
 }
 
 // atomic add
@@ -889,7 +951,8 @@ atomic_add_inst::atomic_add_inst(value* ptr, value* val,
 instruction* atomic_add_inst::create(value* ptr, value* val,
                                      const std::string& name,
                                      instruction* next) {
-  return new atomic_add_inst(ptr, val, name, next);
+  context& ctx = ptr->get_type()->get_context();
+  return new (ctx) atomic_add_inst(ptr, val, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -900,22 +963,26 @@ instruction* atomic_add_inst::create(value* ptr, value* val,
 copy_to_shared_inst* copy_to_shared_inst::create(value* arg,
                                                  const std::string& name,
                                                  instruction* next) {
-  return new copy_to_shared_inst(arg->get_type(), INST_COPY_TO_SHARED, arg,
-                                 name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) copy_to_shared_inst(arg->get_type(), INST_COPY_TO_SHARED,
+                                       arg, name, next);
 }
 
 // copy from shared
 copy_from_shared_inst* copy_from_shared_inst::create(value* arg,
                                                      const std::string& name,
                                                      instruction* next) {
-  return new copy_from_shared_inst(arg->get_type(), INST_COPY_FROM_SHARED, arg,
-                                   name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx) copy_from_shared_inst(
+      arg->get_type(), INST_COPY_FROM_SHARED, arg, name, next);
 }
 
 // recoalesce
 recoalesce_inst* recoalesce_inst::create(value* arg, const std::string& name,
                                          instruction* next) {
-  return new recoalesce_inst(arg->get_type(), INST_RECOALESCE, arg, name, next);
+  context& ctx = arg->get_type()->get_context();
+  return new (ctx)
+      recoalesce_inst(arg->get_type(), INST_RECOALESCE, arg, name, next);
 }
 
 // barrier
@@ -925,7 +992,7 @@ barrier_inst::barrier_inst(context& ctx, const std::string& name,
 
 barrier_inst* barrier_inst::create(context& ctx, const std::string& name,
                                    instruction* next) {
-  return new barrier_inst(ctx, name, next);
+  return new (ctx) barrier_inst(ctx, name, next);
 }
 
 // nv_dynamic_program_idx
@@ -935,7 +1002,7 @@ make_range_dyn::make_range_dyn(type* ty, const std::string& name,
 
 make_range_dyn* make_range_dyn::create(type* ty, const std::string& name,
                                        instruction* next) {
-  return new make_range_dyn(ty, name, next);
+  return new (ty->get_context()) make_range_dyn(ty, name, next);
 }
 
 // nv_static_program_idx
@@ -945,10 +1012,12 @@ make_range_sta::make_range_sta(make_range* range)
 make_range* make_range_sta::get_range() const { return range_; }
 
 make_range_sta* make_range_sta::get(make_range* range) {
-  static std::map<make_range*, make_range_sta*> cache;
-  if (cache.find(range) == cache.end())
-    cache.insert({range, new make_range_sta(range)});
-  return cache.at(range);
+  context& ctx = range->get_type()->get_context();
+  return ctx.p_impl->range_constants_.get_or_create(range, [&] {
+    make_range_sta* result = new (ctx) make_range_sta(range);
+    result->set_shared();
+    return result;
+  });
 }
 
 // make_range
@@ -960,7 +1029,7 @@ make_range* make_range::create(constant_int* first, constant_int* last) {
   assert(first->get_type() == last->get_type());
   assert(((constant_int*)first)->get_value() == 0);
   type* ty = tile_type::get(first->get_type(), {(unsigned)last->get_value()});
-  return new make_range(ty, first, last);
+  return new (ty->get_context()) make_range(ty, first, last);
 }
 
 const constant_int* make_range::get_first() const { return first_; }
@@ -67,7 +67,8 @@ ir::value* module::try_remove_trivial_phis(ir::phi_node*& phi) {
     return phi;
   // unique value or self-reference
   ir::value* same = *non_self_ref.begin();
-  std::set<ir::user*> users = phi->get_users();
+  auto phi_users = phi->get_users();
+  std::set<ir::user*> users(phi_users.begin(), phi_users.end());
   phi->replace_all_uses_with(same);
   phi->erase_from_parent();
   for (ir::user* u : users)
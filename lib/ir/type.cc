@@ -1,6 +1,7 @@
 #include "tensorscript/ir/type.h"
 
 #include <cassert>
+#include <cstddef>
 #include <stdexcept>
 
 #include "tensorscript/ir/constant.h"
@@ -15,6 +16,17 @@ namespace ir {
 //                              type class
 //===----------------------------------------------------------------------===//
 
+// allocation
+void* type::operator new(std::size_t size, context& ctx) {
+  return ctx.p_impl->allocate(size, alignof(std::max_align_t), [](void* p) {
+    static_cast<type*>(p)->~type();
+  });
+}
+
+void type::operator delete(void* ptr, context& ctx) {
+  ctx.p_impl->cancel(ptr);
+}
+
 // attributes
 type* type::get_scalar_ty() const {
   if (is_tile_ty())
@@ -160,11 +172,10 @@ pointer_type* pointer_type::get(type* elt_ty, unsigned address_space) {
   assert(elt_ty && "Can't get a pointer to <null> type!");
   assert(is_valid_elt_ty(elt_ty) && "Invalid type for pointer element!");
   // look-up
-  context_impl* impl = elt_ty->get_context().p_impl.get();
-  pointer_type*& entry = impl->ptr_tys[std::make_pair(elt_ty, address_space)];
-  if (!entry)
-    entry = new pointer_type(elt_ty, address_space);
-  return entry;
+  context& ctx = elt_ty->get_context();
+  return ctx.p_impl->ptr_tys.get_or_create(
+      std::make_pair(elt_ty, address_space),
+      [&] { return new (ctx) pointer_type(elt_ty, address_space); });
 }
 
 //===----------------------------------------------------------------------===//
@@ -212,11 +223,10 @@ tile_type* tile_type::get(type* elt_ty, const tile_shapes_t& shapes) {
   assert(shapes.size() && "Can't create a tile with empty shapes!");
   assert(is_valid_elt_ty(elt_ty) && "Invalid type for tile element!");
   // look-up
-  context_impl* impl = elt_ty->get_context().p_impl.get();
-  tile_type*& entry = impl->tile_tys[std::make_pair(elt_ty, shapes)];
-  if (!entry)
-    entry = new tile_type(elt_ty, shapes);
-  return entry;
+  context& ctx = elt_ty->get_context();
+  return ctx.p_impl->tile_tys.get_or_create(
+      std::make_pair(elt_ty, shapes),
+      [&] { return new (ctx) tile_type(elt_ty, shapes); });
 }
 
 tile_type* tile_type::get_same_shapes(type* ty, type* ref) {
@@ -237,7 +247,7 @@ function_type::function_type(type* ret_ty, const std::vector<type*>& param_tys)
 
 function_type* function_type::get(type* ret_ty,
                                   const std::vector<type*>& param_tys) {
-  return new function_type(ret_ty, param_tys);
+  return new (ret_ty->get_context()) function_type(ret_ty, param_tys);
 }
 
 }  // namespace ir
@@ -1,8 +1,11 @@
 #include "tensorscript/ir/value.h"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
+#include "tensorscript/ir/context.h"
+#include "tensorscript/ir/context_impl.h"
 #include "tensorscript/ir/instructions.h"
 
 namespace tensorscript {
@@ -10,21 +13,59 @@ namespace ir {
 
 class type;
 
+//===----------------------------------------------------------------------===//
+//                               use class
+//===----------------------------------------------------------------------===//
+
+unsigned use::get_operand_no() const { return this - user_->ops_; }
+
+void use::set(value* v) {
+  // uniqued constants do not track their uses
+  if (val_ && !val_->shared_)
+    remove_from_list();
+  val_ = v;
+  if (v && !v->shared_)
+    add_to_list(&v->uses_);
+}
+
 //===----------------------------------------------------------------------===//
 //                               value class
 //===----------------------------------------------------------------------===//
 
-value::value(type* ty, const std::string& name) : ty_(ty) { set_name(name); }
+value::value(type* ty, const std::string& name)
+    : uses_(nullptr), shared_(false), ty_(ty) {
+  set_name(name);
+}
 
-void value::add_use(user* arg) { users_.insert(arg); }
+value::value(const value& other)
+    : name_(other.name_), uses_(nullptr), shared_(false), ty_(other.ty_) {}
 
-unsigned value::erase_use(user* arg) { return users_.erase(arg); }
+void* value::operator new(std::size_t size, context& ctx) {
+  return ctx.p_impl->allocate(size, alignof(std::max_align_t), [](void* p) {
+    static_cast<value*>(p)->~value();
+  });
+}
+
+void value::operator delete(void* ptr, context& ctx) {
+  ctx.p_impl->cancel(ptr);
+}
+
+unsigned value::get_num_uses() const {
+  unsigned result = 0;
+  for (use* u = uses_; u; u = u->get_next())
+    result++;
+  return result;
+}
 
 // TODO: automatic naming scheme + update symbol table
 void value::set_name(const std::string& name) { name_ = name; }
 
 void value::replace_all_uses_with(value* target) {
-  throw std::runtime_error("not implemented");
+  if (target == this)
+    return;
+  // every call unlinks the head of the list
+  while (uses_)
+    uses_->set(target);
 }
 
 void visitor::visit_value(ir::value* v) { v->accept(this); }
@@ -32,34 +73,78 @@ void visitor::visit_value(ir::value* v) { v->accept(this); }
 //===----------------------------------------------------------------------===//
 //                               user class
 //===----------------------------------------------------------------------===//
+
+user::user(type* ty, unsigned num_ops, const std::string& name)
+    : value(ty, name), num_ops_(num_ops), num_hidden_(0) {
+  init_ops(num_ops);
+}
+
+user::user(const user& other)
+    : value(other), num_ops_(other.num_ops_), num_hidden_(other.num_hidden_) {
+  init_ops(other.size_);
+  for (unsigned i = 0; i < size_; i++)
+    ops_[i].set(other.ops_[i].get());
+}
+
+void user::init_ops(unsigned size) {
+  ops_ = inline_ops_;
+  size_ = 0;
+  capacity_ = num_inline_ops;
+  for (use& u : inline_ops_)
+    u.user_ = this;
+  resize_storage(size);
+}
+
+void user::resize_storage(unsigned size) {
+  // shrink
+  for (unsigned i = size; i < size_; i++)
+    ops_[i].set(nullptr);
+  if (size <= capacity_) {
+    size_ = size;
+    return;
+  }
+  // grow geometrically; the old array stays in the arena
+  unsigned capacity = std::max(size, 2 * capacity_);
+  context_impl* impl = get_type()->get_context().p_impl.get();
+  void* mem = impl->allocate(capacity * sizeof(use), alignof(use), nullptr);
+  use* ops = new (mem) use[capacity];
+  for (unsigned i = 0; i < capacity; i++)
+    ops[i].user_ = this;
+  // move the uses to the new slots
+  for (unsigned i = 0; i < size_; i++) {
+    value* v = ops_[i].get();
+    ops_[i].set(nullptr);
+    ops[i].set(v);
+  }
+  ops_ = ops;
+  size_ = size;
+  capacity_ = capacity;
+}
+
 void user::set_operand(unsigned i, value* x) {
-  assert(i < ops_.size() && "set_operand() out of range!");
-  ops_[i] = x;
-  x->add_use(this);
+  assert(i < size_ && "set_operand() out of range!");
+  ops_[i].set(x);
 }
 
 value* user::get_operand(unsigned i) const {
-  assert(i < ops_.size() && "get_operand() out of range!");
-  return ops_[i];
+  assert(i < size_ && "get_operand() out of range!");
+  return ops_[i].get();
 }
 
 unsigned user::get_num_operands() const { return num_ops_; }
 
 unsigned user::get_num_hidden() const { return num_hidden_; }
 
-void user::replace_all_uses_with(value* target) {
-  for (auto it = users_.begin(); it != users_.end(); it++) {
-    (*it)->replace_uses_of_with(this, target);
-  }
+void user::replace_uses_of_with(value* before, value* after) {
+  for (unsigned i = 0; i < size_; i++)
+    if (ops_[i].get() == before)
+      ops_[i].set(after);
 }
 
-void user::replace_uses_of_with(value* before, value* after) {
-  for (size_t i = 0; i < ops_.size(); i++)
-    if (ops_[i] == before)
-      ops_[i] = after;
-  after->add_use(this);
-  before->erase_use(this);
+void user::drop_all_references() {
+  for (unsigned i = 0; i < size_; i++)
+    ops_[i].set(nullptr);
 }
 
 }  // namespace ir
-}  // namespace tensorscript
\ No newline at end of file
+}  // namespace tensorscript